@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include "color.h"
+#include "settings.h"
+
+/*- Variables ---------------------------------------------------------------*/
+/* Default curve, (k/64)^2.8 in 8.8 output units */
+static const uint16_t gamma16[COLOR_SEGS+1] = {
+	    0,     1,     4,    12,    28,    52,    86,   133,
+	  193,   269,   361,   471,   601,   753,   926,  1123,
+	 1346,  1595,  1872,  2178,  2514,  2882,  3283,  3718,
+	 4189,  4696,  5241,  5825,  6449,  7115,  7824,  8576,
+	 9373, 10217, 11108, 12047, 13035, 14075, 15166, 16310,
+	17508, 18762, 20071, 21438, 22864, 24348, 25894, 27501,
+	29171, 30905, 32703, 34568, 36499, 38499, 40568, 42706,
+	44916, 47198, 49554, 51983, 54488, 57069, 59727, 62464,
+	65280
+};
+
+/* 2^-(1/2^k) in 0.16 fixed point, k = 1..16 */
+static const uint16_t exp2_frac[16] = {
+	46341, 55109, 60097, 62757, 64132, 64830, 65182, 65359,
+	65447, 65492, 65514, 65525, 65530, 65533, 65535, 65535
+};
+
+/*
+ * Output tables, one per channel: the gamma curve with the channel limit
+ * and the global brightness folded in. Entries are 8.8 outputs at 64 evenly
+ * spaced 16 bit levels, color_level() interpolates in between. Both scale
+ * the level before gamma, a limit of 100 gives the same maximum as
+ * clamping the level at 100.
+ */
+uint16_t color_lut[3][COLOR_SEGS+1];
+
+/* Bit reversed frame order, consecutive frames spread the dither evenly */
+const uint8_t color_dither_seq[16] = {
+	0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15
+};
+
+
+/*- Implementations ---------------------------------------------------------*/
+
+/*
+ * x^(exp/10) for x in 0.16, as 2^(exp/10 * log2(x)). The log comes from
+ * repeated squaring of the mantissa, the power from a product of 2^-(1/2^k).
+ * Result in 8.8 output units.
+ */
+static uint16_t color_gamma_calc(uint32_t x, uint8_t exp)
+{
+	uint32_t e = 0, frac = 0, r = 0x10000;
+
+	if (!x)
+		return 0;
+
+	// -log2(x) in 16.16
+	while (x < 0x10000) {
+		x <<= 1;
+		e += 0x10000;
+	}
+	for (uint32_t b = 0x8000; b; b >>= 1) {
+		x = ((uint64_t)x * x) >> 16;
+		if (x >= 0x20000) {
+			x >>= 1;
+			frac |= b;
+		}
+	}
+	e = ((e - frac) * exp + 5) / 10;
+
+	if ((e >> 16) > 16)
+		return 0;
+	for (uint8_t k = 0; k < 16; k++) {
+		if (e & (0x8000 >> k))
+			r = (r * exp2_frac[k] + 0x8000) >> 16;
+	}
+	r = (r + ((1 << (e >> 16)) >> 1)) >> (e >> 16);
+
+	return (r * 255 + 0x80) >> 8;
+}
+
+/* Curve value at x in 0.16, the default exponent interpolates gamma16 */
+static uint16_t color_gamma(uint32_t x, uint8_t exp)
+{
+	if (exp != COLOR_GAMMA_DEFAULT)
+		return color_gamma_calc(x, exp);
+	if (x >= 0x10000)
+		return gamma16[COLOR_SEGS];
+
+	const uint16_t *g = &gamma16[x >> COLOR_SEG_SHIFT];
+	return g[0] + (((uint32_t)(g[1] - g[0]) * (x & COLOR_SEG_MASK)) >> COLOR_SEG_SHIFT);
+}
+
+/* Only a non-default exponent costs a calculation, the tables are regenerated either way */
+static void color_update(void)
+{
+	for (uint8_t c = 0; c < 3; c++) {
+		uint32_t scale = (uint32_t)settings.limit[c] * settings.brightness;
+
+		for (uint8_t k = 0; k <= COLOR_SEGS; k++)
+			color_lut[c][k] = color_gamma(((uint32_t)k << COLOR_SEG_SHIFT) * scale / 65025, settings.gamma[c]);
+	}
+}
+
+/* Tables for the loaded settings, call after settings_load() */
+void color_init(void)
+{
+	color_update();
+}
+
+void color_set_brightness(uint8_t value)
+{
+	settings.brightness = value;
+	color_update();
+}
+
+void color_set_limit(enum color_channel channel, uint8_t value)
+{
+	settings.limit[channel] = value;
+	color_update();
+}
+
+/* Exponent in tenths, 28 is 2.8 */
+void color_set_gamma(enum color_channel channel, uint8_t exp)
+{
+	if (!exp || (exp > COLOR_GAMMA_MAX))
+		return;
+	settings.gamma[channel] = exp;
+	color_update();
+}
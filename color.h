@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _COLOR_H_
+#define _COLOR_H_
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+
+/*- Definitions -------------------------------------------------------------*/
+#define COLOR_GAMMA_DEFAULT	28	// exponent in tenths, built into flash
+#define COLOR_GAMMA_MAX		50
+#define COLOR_SEGS		64	// interpolated segments per output table
+#define COLOR_SEG_SHIFT		10	// 16 bit level to segment
+#define COLOR_SEG_MASK		((1 << COLOR_SEG_SHIFT) - 1)
+#define COLOR_DITHER_MASK	0xF0	// output fraction bits shown by dithering
+// Tables are in wire order
+enum color_channel {
+	COLOR_G,
+	COLOR_R,
+	COLOR_B
+};
+
+/*- Variables ---------------------------------------------------------------*/
+extern uint16_t color_lut[3][COLOR_SEGS+1];
+extern const uint8_t color_dither_seq[16];
+
+/*- Prototypes --------------------------------------------------------------*/
+void color_init(void);
+void color_set_brightness(uint8_t value);
+void color_set_limit(enum color_channel channel, uint8_t value);
+void color_set_gamma(enum color_channel channel, uint8_t exp);
+
+/*- Implementations ---------------------------------------------------------*/
+
+/* 16 bit level to an 8.8 output, gamma, limit and brightness applied */
+static inline uint16_t color_level(enum color_channel channel, uint16_t level)
+{
+	const uint16_t *lut = &color_lut[channel][level >> COLOR_SEG_SHIFT];
+
+	return lut[0] + (((uint32_t)(lut[1] - lut[0]) * (level & COLOR_SEG_MASK)) >> COLOR_SEG_SHIFT);
+}
+
+/*
+ * Rounding threshold for an 8.8 output, the phase should advance every frame.
+ * Over 16 frames the average output carries 4 more bits than the wire.
+ */
+static inline uint8_t color_dither(uint16_t phase)
+{
+	return (color_dither_seq[phase & 15] << 4) | 0x08;
+}
+
+#endif // _COLOR_H_
@@ -31,30 +31,82 @@
 #include "hal_gpio.h"
 #include "dma.h"
 
-/*- Data --------------------------------------------------------------------*/
-extern uint8_t out_buf[];
+/*- Definitions -------------------------------------------------------------*/
+#define DMA_CHANNELS	3
 
-volatile DmacDescriptor descarray[1];
-DmacDescriptor descarray_wb[1];
+/*- Data --------------------------------------------------------------------*/
+static volatile DmacDescriptor descarray[DMA_CHANNELS] __attribute__((aligned(16)));
+static DmacDescriptor descarray_wb[DMA_CHANNELS] __attribute__((aligned(16)));
+static dma_cb_t dma_callback[DMA_CHANNELS];
 
 /*- Functions --------------------------------------------------------------*/
 void dma_init(void)
 {
-	descarray[0].BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_STEPSEL;
-	descarray[0].BTCNT.reg = 600;
-	descarray[0].DSTADDR.reg = (uint32_t)&(SERCOM0->SPI.DATA.reg);
-	descarray[0].SRCADDR.reg = (uint32_t)out_buf + 600;
-	descarray[0].DESCADDR.reg = 0;
-
 	DMAC->BASEADDR.reg = (uint32_t)descarray;
 	DMAC->WRBADDR.reg = (uint32_t)descarray_wb;
 
 	PM->AHBMASK.bit.DMAC_ = 1;
 	PM->APBBMASK.bit.DMAC_ = 1;
 	DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xf);
+}
+
+/* One beat per trigger, trigsrc is a peripheral DMAC_ID such as SERCOM0_DMAC_ID_TX */
+void dma_ch_trigger(uint8_t channel, uint8_t trigsrc)
+{
+	DMAC->CHID.reg = channel; // select channel
+	DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(trigsrc) | DMAC_CHCTRLB_TRIGACT_BEAT;
+}
+
+/* First descriptor of a channel, the one fetched when the channel is enabled */
+volatile DmacDescriptor *dma_ch_desc(uint8_t channel)
+{
+	return &descarray[channel];
+}
+
+/*
+ * Fill a block transfer descriptor, src is the start of the block even when incrementing.
+ * STEPSIZE applies to the address STEPSEL picks, beats are then that many beats apart.
+ */
+void dma_desc_set(volatile DmacDescriptor *desc, const volatile void *src, volatile void *dst,
+		uint16_t count, uint16_t btctrl, volatile DmacDescriptor *next)
+{
+	uint32_t bytes = count << ((btctrl & DMAC_BTCTRL_BEATSIZE_Msk) >> DMAC_BTCTRL_BEATSIZE_Pos);
+	uint8_t step = (btctrl & DMAC_BTCTRL_STEPSIZE_Msk) >> DMAC_BTCTRL_STEPSIZE_Pos;
+	uint8_t src_step = (btctrl & DMAC_BTCTRL_STEPSEL) ? step : 0;
+	uint8_t dst_step = (btctrl & DMAC_BTCTRL_STEPSEL) ? 0 : step;
+
+	desc->BTCTRL.reg = DMAC_BTCTRL_VALID | btctrl;
+	desc->BTCNT.reg = count;
+	desc->SRCADDR.reg = (uint32_t)src + ((btctrl & DMAC_BTCTRL_SRCINC) ? bytes << src_step : 0);
+	desc->DSTADDR.reg = (uint32_t)dst + ((btctrl & DMAC_BTCTRL_DSTINC) ? bytes << dst_step : 0);
+	desc->DESCADDR.reg = (uint32_t)next;
+}
+
+/* Called from DMAC_Handler with the channel flags, blocks need DMAC_BTCTRL_BLOCKACT_INT */
+void dma_ch_callback(uint8_t channel, dma_cb_t cb)
+{
+	dma_callback[channel] = cb;
+
+	DMAC->CHID.reg = channel; // select channel
+	DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL | DMAC_CHINTENSET_TERR;
+	NVIC_EnableIRQ(DMAC_IRQn);
+}
+
+void DMAC_Handler(void)
+{
+	uint8_t chid = DMAC->CHID.reg; // may interrupt a channel select in thread mode
+
+	while (DMAC->INTSTATUS.reg) {
+		uint8_t channel = DMAC->INTPEND.bit.ID;
+		DMAC->CHID.reg = channel;
+		uint8_t flags = DMAC->CHINTFLAG.reg;
+		DMAC->CHINTFLAG.reg = flags;
+
+		if (channel < DMA_CHANNELS && dma_callback[channel])
+			dma_callback[channel](flags);
+	}
 
-	DMAC->CHID.reg = 0; // select channel 0
-	DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(SERCOM0_DMAC_ID_TX) | DMAC_CHCTRLB_TRIGACT_BEAT;
+	DMAC->CHID.reg = chid;
 }
 
 void dma_ch_enable(uint8_t channel)
@@ -63,10 +115,13 @@ void dma_ch_enable(uint8_t channel)
 	DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
 }
 
+/* Returns once the channel stopped, flags it raised meanwhile are dropped */
 void dma_ch_disable(uint8_t channel)
 {
 	DMAC->CHID.reg = channel; // select channel
-	DMAC->CHCTRLA.reg &= !(DMAC_CHCTRLA_ENABLE);
+	DMAC->CHCTRLA.reg &= ~(DMAC_CHCTRLA_ENABLE);
+	while (DMAC->CHCTRLA.bit.ENABLE);
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
 }
 
 bool dma_ch_enabled(uint8_t channel)
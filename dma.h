@@ -31,9 +31,19 @@
 
 /*- Includes ----------------------------------------------------------------*/
 #include <stdint.h>
+#include <stdbool.h>
+#include "sam.h"
+
+/*- Types -------------------------------------------------------------------*/
+typedef void (*dma_cb_t)(uint8_t flags);
 
 /*- Prototypes --------------------------------------------------------------*/
 void dma_init(void);
+void dma_ch_trigger(uint8_t channel, uint8_t trigsrc);
+volatile DmacDescriptor *dma_ch_desc(uint8_t channel);
+void dma_desc_set(volatile DmacDescriptor *desc, const volatile void *src, volatile void *dst,
+		uint16_t count, uint16_t btctrl, volatile DmacDescriptor *next);
+void dma_ch_callback(uint8_t channel, dma_cb_t cb);
 void dma_ch_enable(uint8_t channel);
 void dma_ch_disable(uint8_t channel);
 bool dma_ch_enabled(uint8_t channel);
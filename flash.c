@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "sam.h"
+#include "flash.h"
+
+/*- Functions --------------------------------------------------------------*/
+static void flash_cmd(const void *addr, uint32_t cmd)
+{
+	NVMCTRL->STATUS.reg = NVMCTRL_STATUS_MASK;
+	NVMCTRL->ADDR.reg = (uint32_t)addr >> 1;	// 16 bit words
+	NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | cmd;
+	while (!NVMCTRL->INTFLAG.bit.READY);
+}
+
+void flash_erase_row(const void *addr)
+{
+	flash_cmd(addr, NVMCTRL_CTRLA_CMD_ER);
+}
+
+/* Manual write, so filling the page buffer does not start a write of its own */
+void flash_write_page(const void *addr, const void *data)
+{
+	const uint32_t *src = data;
+	volatile uint32_t *dst = (volatile uint32_t *)addr;
+
+	NVMCTRL->CTRLB.bit.MANW = 1;
+	flash_cmd(addr, NVMCTRL_CTRLA_CMD_PBC);
+	for (uint8_t i = 0; i < FLASH_PAGE/4; i++)
+		dst[i] = src[i];
+	flash_cmd(addr, NVMCTRL_CTRLA_CMD_WP);
+}
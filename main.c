@@ -35,62 +35,27 @@
 #include "sam.h"
 #include "hal_gpio.h"
 #include "tusb.h"
-#include "light_ws2812_cortex.h"
+#include "ws2812.h"
+#include "color.h"
+#include "pattern.h"
+#include "stream.h"
+#include "settings.h"
+#include "prof.h"
 #include "utils.h"
 
 /*- Definitions -------------------------------------------------------------*/
-HAL_GPIO_PIN(NEOPIN,	A, 8)	// Neopixel output
 void tud_suspend_cb(bool);
 
 /*- Implementations ---------------------------------------------------------*/
 
+#define MAXBYTES	(MAXPIX*3)
+#define NEO_TICK	2	// ms per frame and per unit of the delays in settings
+#define NEO_LEVEL_MAX	0x10000	// full brightness in 0.16 fixed point
+#define NEO_WHEEL	64	// timer wheel slots of 1ms, power of 2
+#define NEO_NIL		0xFFFF	// end of a wheel slot list
 
-void rgb_wheel( uint8_t led[], uint8_t pos)
-{
-	if (pos < 85) {
-		//led[0] = 85 - pos;
-		led[0] = 255 - pos * 3;
-		led[1] = pos * 3;
-		led[2] = 0;
-		return;
-	}
-	if (pos < 170) {
-		pos -= 85;
-		led[0] = 0;
-		led[1] = 255 - pos * 3;
-		led[2] = pos;
-		return;
-	}
-	pos -= 170;
-	led[0] = pos * 3;
-	led[1] = 0;
-	led[2] = 85 - pos;
-	return;
-}
-
-uint8_t gamma8[] = {
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-        0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
-        1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
-        2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
-        5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
-        10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
-        17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
-        25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
-        37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
-        51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
-        69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
-        90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
-        115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
-        144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
-        177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
-        215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255 };
-
-#define NUMPIX	50
-#define NUMBYTES	NUMPIX*3
-#define MAXDELAY 0x1F	// 32s total up+down
-#define MAXHOLD	0xFF	// 255ms
-#define	MAXWAIT	0xFFF	// 4.096ms
+// The longest wait must still read as ahead in (int16_t)(due - t)
+_Static_assert((SETTINGS_WAIT_MAX + 1) * NEO_TICK <= INT16_MAX, "wait past the wheel horizon");
 
 enum rgb_states {
 	state_up,
@@ -99,138 +64,364 @@ enum rgb_states {
 	state_wait
 };
 
+/*
+ * Fades are not stepped, the colour is max * level where level is a 0.16
+ * fraction computed from the time since t0 in a single multiply. rate is
+ * the level gained per ms, set so the brightest channel takes as long as
+ * the old one-count-per-step fade. All channels arrive together.
+ */
 struct rand_RGB {
 	uint8_t r_max;
 	uint8_t g_max;
 	uint8_t b_max;
-	uint8_t r_current;
-	uint8_t g_current;
-	uint8_t b_current;
 
-	uint16_t delay_max;
-	uint16_t delay_current;
-	uint16_t delay_hold;
-	uint16_t delay_wait;
+	uint16_t t0;		// millis() the current fade started
+	uint16_t rate;		// level per ms, 0.16 fixed point
+	uint16_t due;		// millis() of the next step, hold or wait end
+	uint16_t next;		// next pixel in the same wheel slot
+	uint8_t delay_max : 5;
+	uint8_t state : 2;	// enum rgb_states
+} PACK;
+
+/*
+ * Pixels sit in the wheel slot of their deadline and are only visited when
+ * that slot comes round. Deadlines more than NEO_WHEEL ms away are simply
+ * skipped until the right lap. Lives in the pattern arena.
+ */
+struct fade_state {
+	uint16_t wheel[NEO_WHEEL];
+	uint16_t wheel_time;		// last millis() processed
+	struct rand_RGB pixels[MAXPIX];
+};
+
+_Static_assert(sizeof(struct fade_state) <= PATTERN_ARENA, "fade state");
+
+static struct fade_state *const fade = (struct fade_state *)pattern_arena;
+
+uint16_t numpix;
+uint8_t pix_dirty[(MAXPIX+7)/8];	// changed since the last render
+static uint8_t pix_stale[(MAXPIX+7)/8];	// changed in the last render, old in the other buffer
+static uint8_t pix_dither[(MAXPIX+7)/8];	// output between two wire levels, rendered every frame
+static uint8_t dither_phase;		// advances once per rendered frame
+static uint8_t frame_buf[2][MAXBYTES];
+uint8_t *out_buf = frame_buf[0];	// back buffer, rendered while the front is on the wire
+static volatile bool frame_busy;	// front buffer owned by ws2812 until frame_done
+static bool frame_ready;		// back buffer holds a frame not yet submitted
+static const struct pattern *pattern = &pattern_fade;
+static bool neo_host;			// frames come from the host, the pattern is paused
+static uint16_t frame_time;		// millis() the back buffer is rendered at
+static uint32_t wire_start;		// cycles() of the last submit
 
-	enum rgb_states state;
-} pixels[NUMPIX] = { 0 };
+/* Runs in DMAC_Handler once the strip latched the front buffer */
+static void frame_done(void)
+{
+	prof_add(PROF_WIRE, cycles() - wire_start);
+	frame_busy = false;
+}
+
+static inline uint8_t *front_buf(void)
+{
+	return (out_buf == frame_buf[0]) ? frame_buf[1] : frame_buf[0];
+}
 
-uint8_t out_buf[NUMBYTES] = { 0 };
-unsigned int seed = 1;
+/* Hand the back buffer to ws2812 and render the next frame into the other one */
+static void frame_submit(void)
+{
+	frame_busy = true;
+	wire_start = cycles();
+	ws2812_submit(out_buf, numpix*3, frame_done);
+	out_buf = front_buf();
+	frame_ready = false;
+}
 
 void neo_init(struct rand_RGB *pixel)
 {
-	pixel->r_max = rand_r(&seed) & 0xFF;
-	pixel->g_max = rand_r(&seed) & 0xFF;
-	pixel->b_max = LIMIT(rand_r(&seed) & 0xFF, 100);
-	pixel->delay_max = rand_r(&seed) & MAXDELAY;
-	pixel->delay_hold = rand_r(&seed) & MAXHOLD;
-	pixel->delay_wait = rand_r(&seed) & MAXWAIT;
+	uint32_t r = rand32();
+
+	pixel->r_max = r;
+	pixel->g_max = r >> 8;
+	pixel->b_max = r >> 16;
+	pixel->delay_max = (r >> 24) % (settings.delay+1);
+	pixel->state = state_up;
 }
 
-void neo_init_all(void)
+/* Start the up fade, rate is kept for the down fade */
+static void neo_fade(struct rand_RGB *pixel, uint16_t now)
 {
-	for (uint8_t i = 0; i < NUMPIX; i++) {
-		neo_init(&pixels[i]);
-	}
+	uint8_t steps = pixel->r_max;
+	uint32_t duration;
 
-	for (uint8_t i = 0; i < NUMPIX; i++) {
-		out_buf[(i*3)] = gamma8[pixels[i].g_current];
-		out_buf[(i*3)+1] = gamma8[pixels[i].r_current];
-		out_buf[(i*3)+2] = gamma8[pixels[i].b_current];
-	}
-	ws2812_sendarray(out_buf, NUMBYTES);
-	delay_us(200);
+	if (pixel->g_max > steps)
+		steps = pixel->g_max;
+	if (pixel->b_max > steps)
+		steps = pixel->b_max;
+	duration = (uint32_t)steps * (pixel->delay_max+1) * NEO_TICK;
+
+	pixel->t0 = now;
+	pixel->rate = duration ? LIMIT(NEO_LEVEL_MAX / duration, 0xFFFF) : 0xFFFF;
 }
 
-void neo_task(void)
+/* Brightness of a pixel at now, 0 to NEO_LEVEL_MAX */
+static uint32_t neo_level(struct rand_RGB *pixel, uint16_t now)
 {
-	for (uint8_t i = 0; i < NUMPIX; i++) {
-		if (pixels[i].state == state_up) {
-			if (pixels[i].delay_current < pixels[i].delay_max) {
-				pixels[i].delay_current++;
-				continue;
-			}
-			pixels[i].delay_current = 0;
-
-			if (pixels[i].r_current < pixels[i].r_max)
-				pixels[i].r_current++;
-			if (pixels[i].g_current < pixels[i].g_max)
-				pixels[i].g_current++;
-			if (pixels[i].b_current < pixels[i].b_max)
-				pixels[i].b_current++;
-
-			if ((pixels[i].r_current >= pixels[i].r_max) &&
-					(pixels[i].g_current >= pixels[i].g_max) &&
-					(pixels[i].b_current >= pixels[i].b_max))
-				pixels[i].state = state_hold;
-		}
-		else if (pixels[i].state == state_hold) {
-			if (pixels[i].delay_hold) {
-				pixels[i].delay_hold--;
+	uint32_t level = (uint32_t)(uint16_t)(now - pixel->t0) * pixel->rate;
+
+	if (level > NEO_LEVEL_MAX)
+		level = NEO_LEVEL_MAX;
+
+	if (pixel->state == state_up)
+		return level;
+	if (pixel->state == state_hold)
+		return NEO_LEVEL_MAX;
+	if (pixel->state == state_down)
+		return NEO_LEVEL_MAX - level;
+	return 0;
+}
+
+static void neo_schedule(uint16_t i)
+{
+	uint16_t *slot = &fade->wheel[fade->pixels[i].due & (NEO_WHEEL-1)];
+
+	fade->pixels[i].next = *slot;
+	*slot = i;
+}
+
+/* Every pixel needs rendering again, e.g. after the colour tables changed */
+void neo_dirty_all(void)
+{
+	memset(pix_dirty, 0xFF, sizeof(pix_dirty));
+}
+
+/* One channel at a 16 bit level to a wire byte, dithered on threshold d */
+static inline uint8_t neo_channel(enum color_channel c, uint16_t level, uint8_t d, bool *dither)
+{
+	uint16_t out = color_level(c, level);
+
+	if (out & COLOR_DITHER_MASK)
+		*dither = true;
+	return (out + d) >> 8;
+}
+
+/*
+ * Gamma correct changed pixels into the back buffer. Pixels written last time
+ * are copied again, the back buffer missed them. Pixels whose output falls
+ * between two wire levels are dithered and count as changed every frame.
+ * Returns false when nothing changed since the last render, the back buffer
+ * then equals the front.
+ */
+static bool neo_render(void)
+{
+	bool changed = false;
+
+	dither_phase++;
+	for (uint16_t k = 0; k < (numpix+7)/8; k++) {
+		// neo_dirty_all() also marks the bits past numpix in the last group
+		if (k == numpix/8)
+			pix_dirty[k] &= (1 << (numpix & 7)) - 1;
+		pix_dirty[k] |= pix_dither[k];
+		uint8_t mask = pix_dirty[k] | pix_stale[k];
+
+		if (!mask)
+			continue;
+		if (pix_dirty[k])
+			changed = true;
+		pix_stale[k] = pix_dirty[k];
+		pix_dirty[k] = 0;
+
+		for (uint16_t i = k*8; mask; i++, mask >>= 1) {
+			if (!(mask & 1))
 				continue;
-			}
-			pixels[i].state = state_down;
+			uint16_t level[3];
+			uint8_t d = color_dither(dither_phase + i);	// neighbours out of step
+			bool dither = false;
+			pattern->render(i, frame_time, level);
+			out_buf[(i*3)] = neo_channel(COLOR_G, level[0], d, &dither);
+			out_buf[(i*3)+1] = neo_channel(COLOR_R, level[1], d, &dither);
+			out_buf[(i*3)+2] = neo_channel(COLOR_B, level[2], d, &dither);
+			if (dither)
+				pix_dither[k] |= 1 << (i & 7);
+			else
+				pix_dither[k] &= ~(1 << (i & 7));
 		}
-		else if (pixels[i].state == state_down) {
-			if (pixels[i].delay_current < pixels[i].delay_max) {
-				pixels[i].delay_current++;
-				continue;
-			}
-			pixels[i].delay_current = 0;
+	}
 
-			if (pixels[i].r_current)
-				pixels[i].r_current--;
-			if (pixels[i].g_current)
-				pixels[i].g_current--;
-			if (pixels[i].b_current)
-				pixels[i].b_current--;
+	return changed;
+}
 
-			if (!(pixels[i].r_current) && !(pixels[i].g_current) && !(pixels[i].b_current))
-				pixels[i].state = state_wait;
-		}
-		else if (pixels[i].state == state_wait) {
-			if (pixels[i].delay_wait) {
-				pixels[i].delay_wait--;
-				continue;
-			}
+/*
+ * Advance one pixel whose deadline has passed, returns ms until it is due
+ * again. Fading pixels come back every frame, holds and waits at their end.
+ */
+static uint16_t neo_step(uint16_t i, uint16_t now)
+{
+	struct rand_RGB *pixel = &fade->pixels[i];
+	bool done = ((uint32_t)(uint16_t)(now - pixel->t0) * pixel->rate) >= NEO_LEVEL_MAX;
 
-			neo_init(&pixels[i]);
-			pixels[i].state = state_up;
+	if (pixel->state == state_up) {
+		neo_dirty(i);
+		if (done) {
+			pixel->state = state_hold;
+			return ((rand32() % (settings.hold+1))+1)*NEO_TICK;
+		}
+		return NEO_TICK;
+	}
+	else if (pixel->state == state_hold) {
+		pixel->state = state_down;
+		pixel->t0 = now;
+		return NEO_TICK;
+	}
+	else if (pixel->state == state_down) {
+		neo_dirty(i);
+		if (done) {
+			pixel->state = state_wait;
+			return ((rand32() % (settings.wait+1))+1)*NEO_TICK;
 		}
-		else
-			pixels[i].state = state_up;
+		return NEO_TICK;
+	}
+
+	neo_init(pixel);
+	neo_fade(pixel, now);
+	return NEO_TICK;
+}
+
+/* Random fade, every pixel starts fading up at now */
+static void fade_init(uint16_t now)
+{
+	memset(fade, 0, sizeof(*fade));
+	memset(fade->wheel, 0xFF, sizeof(fade->wheel));
+	fade->wheel_time = now;
+
+	for (uint16_t i = 0; i < numpix; i++) {
+		neo_init(&fade->pixels[i]);
+		neo_fade(&fade->pixels[i], now);
+		fade->pixels[i].due = now + NEO_TICK;
+		neo_schedule(i);
 	}
+}
+
+/* Run every wheel slot up to now, cost follows the number of pixels due */
+static void fade_step(uint16_t now)
+{
+	while (fade->wheel_time != now) {
+		uint16_t t = ++fade->wheel_time;
+
+		uint16_t *slot = &fade->wheel[t & (NEO_WHEEL-1)];
+		uint16_t i = *slot;
+		*slot = NEO_NIL;
 
-	for (uint8_t i = 0; i < NUMPIX; i++) {
-		out_buf[(i*3)] = gamma8[pixels[i].g_current];
-		out_buf[(i*3)+1] = gamma8[pixels[i].r_current];
-		out_buf[(i*3)+2] = gamma8[pixels[i].b_current];
+		while (i != NEO_NIL) {
+			uint16_t next = fade->pixels[i].next;
+
+			if ((int16_t)(fade->pixels[i].due - t) <= 0)
+				fade->pixels[i].due = t + neo_step(i, t);
+			neo_schedule(i);
+			i = next;
+		}
 	}
+}
+
+static void fade_render(uint16_t i, uint16_t now, uint16_t level[3])
+{
+	struct rand_RGB *pixel = &fade->pixels[i];
+	uint32_t l = neo_level(pixel, now);
+
+	level[COLOR_G] = (pixel->g_max * l) >> 8;
+	level[COLOR_R] = (pixel->r_max * l) >> 8;
+	level[COLOR_B] = (pixel->b_max * l) >> 8;
+}
+
+const struct pattern pattern_fade = { 'f', fade_init, fade_step, fade_render };
+
+void neo_init_all(void)
+{
+	neo_host = false;
+	frame_time = millis();
+	pattern->init(frame_time);
+
+	neo_dirty_all();
+	memset(pix_stale, 0, sizeof(pix_stale));
+	memset(pix_dither, 0, sizeof(pix_dither));
+	neo_render();
+	frame_submit();
+}
+
+/*
+ * Advance the running pattern to now and render what it changed. Returns
+ * true if the back buffer holds a new frame to send.
+ */
+bool neo_task(void)
+{
+	frame_time = millis();
+	pattern->step(frame_time);
 
-	ws2812_sendarray(out_buf, NUMBYTES);
+	return neo_render();
+}
+
+/* Blank the old string length, then restart every pixel */
+void neo_set_numpix(uint16_t n)
+{
+	if (!n || (n > MAXPIX))
+		return;
+
+	ws2812_send(NULL, numpix*3);
+	numpix = settings.numpix = n;
+	neo_init_all();
+}
+
+/*
+ * Switch patterns between frames, this also ends host streaming. The string
+ * is not blanked, the new pattern simply redraws every pixel in the next frame.
+ */
+void neo_set_pattern(char key)
+{
+	const struct pattern *p = pattern_find(key);
+
+	if (!p)
+		return;
+
+	pattern = p;
+	settings.pattern = key;
+	neo_host = false;
+	pattern->init(millis());
+	neo_dirty_all();
 }
 
 //-----------------------------------------------------------------------------
 int main(void)
 {
-	HAL_GPIO_NEOPIN_out();
+	settings_load();
+	rand_init();
+	ws2812_init();
+	color_init();
+	numpix = LIMIT(settings.numpix, MAXPIX);
+	settings.wait = LIMIT(settings.wait, SETTINGS_WAIT_MAX);	// saved before the bound was fixed
+	if (pattern_find(settings.pattern))
+		pattern = pattern_find(settings.pattern);
 	neo_init_all();
 	tusb_init();
 
 	uint8_t line[25];
 
 	uint32_t neo_time = millis();
-	//uint8_t neo_pos = 0;
+
+	uint32_t loop_start = cycles();
 
 	while (1)
 	{
+		uint32_t t = cycles();
+		prof_add(PROF_LOOP, t - loop_start);
+		loop_start = t;
+
 		tud_task();
+		prof_add(PROF_USB, cycles() - t);
+
+		// Host frames land in the back buffer once it is free
+		stream_task(frame_ready ? NULL : out_buf, front_buf(), numpix*3);
 
 		if (cdc_task(line, 25)) {
 			if (line[0] == 'r') {
 				char s[20];
-				itoa(rand_r(&seed)&0xFF, s, 10);
+				itoa(rand32()&0xFF, s, 10);
 				tud_cdc_write_str(s);
 				tud_cdc_write_char('\n');
 			}
@@ -239,29 +430,90 @@ int main(void)
 			}
 			else if (line[0] == 'z') {
 				uint32_t pausetime = millis();
-				ws2812_sendzero(NUMBYTES);
+				ws2812_send(NULL, numpix*3);
 				while ((millis() - pausetime) < 1000);
 			}
 			else if (line[0] == 'Z') {
 				tud_suspend_cb(0);
 			}
+			else if (line[0] == 'n') {
+				neo_set_numpix(atoi2((char *)&line[1]));
+			}
+			else if (line[0] == 'd') {
+				uint16_t value = atoi2((char *)&line[2]);
+				if (line[1] == 'u')
+					settings.delay = LIMIT(value, SETTINGS_DELAY_MAX);
+				else if (line[1] == 'h')
+					settings.hold = LIMIT(value, 255);
+				else if (line[1] == 'w')
+					settings.wait = LIMIT(value, SETTINGS_WAIT_MAX);
+			}
+			else if (line[0] == 't') {
+				char s[12];
+				prof_print();
+				utoa(ws2812_overruns(), s, 10);
+				cdc_print("overrun\t");
+				cdc_print(s);
+				cdc_print("\n");
+			}
+			else if (line[0] == 'T') {
+				prof_reset();
+				ws2812_overruns_clear();
+			}
+			else if (line[0] == 'w') {
+				settings_save();
+			}
+			else if (line[0] == 'm') {
+				neo_set_pattern(line[1]);
+			}
+			else if (line[0] == 'b') {
+				color_set_brightness(LIMIT(atoi2((char *)&line[1]), 255));
+				neo_dirty_all();
+			}
+			else if (line[0] == 'c') {
+				uint8_t value = LIMIT(atoi2((char *)&line[2]), 255);
+				if (line[1] == 'r')
+					color_set_limit(COLOR_R, value);
+				else if (line[1] == 'g')
+					color_set_limit(COLOR_G, value);
+				else if (line[1] == 'b')
+					color_set_limit(COLOR_B, value);
+				neo_dirty_all();
+			}
+			else if (line[0] == 'g') {
+				if (line[1] == 'r')
+					color_set_gamma(COLOR_R, atoi2((char *)&line[2]));
+				else if (line[1] == 'g')
+					color_set_gamma(COLOR_G, atoi2((char *)&line[2]));
+				else if (line[1] == 'b')
+					color_set_gamma(COLOR_B, atoi2((char *)&line[2]));
+				else {
+					for (uint8_t c = 0; c < 3; c++)
+						color_set_gamma(c, atoi2((char *)&line[1]));
+				}
+				neo_dirty_all();
+			}
 		}
 
-		// Should be greater than 30us * NUMPIX
-		if (millis() - neo_time >= 2) {
-			neo_task();
-			neo_time = millis();
-		}
-		/*
-		if (millis() - neo_time >= 0x1F) {
+#if CFG_TUD_VENDOR
+		if (tud_vendor_available())
+			stream_read(STREAM_VENDOR);
+#endif
+
+		if (stream_claimed())
+			neo_host = true;
+		if (stream_frame())
+			frame_ready = true;
+
+		// Next frame is computed while the previous one is on the wire
+		if (!neo_host && !frame_ready && (millis() - neo_time >= 2)) {
+			t = cycles();
+			frame_ready = neo_task();
+			prof_add(PROF_NEO, cycles() - t);
 			neo_time = millis();
-			for (uint8_t i = 0; i < NUMPIX; i++) {
-				rgb_wheel(&out_buf[i*3], neo_pos+5*i);
-			}
-			neo_pos+=1;
-			ws2812_sendarray(out_buf, NUMBYTES);
 		}
-		*/
+		if (frame_ready && !frame_busy)
+			frame_submit();
 	}
 
 	return 0;
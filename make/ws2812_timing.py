@@ -0,0 +1,148 @@
+#!/usr/bin/env python
+#
+# Checks the WS2812 waveform a built ELF will put on the wire against the
+# WS2812B datasheet, without a scope. make timing passes the backend's
+# object, which keeps the tables the firmware may have folded into code.
+#
+# SPI backend (ws2812_spi.c): the ws2812_nibble table is read back from the
+# ELF and every symbol is timed at the SPI clock spi_init sets for
+# --spi-freq, SPI_FREQ of the build.
+#
+# TCC and parallel backends (ws2812_tcc.c, ws2812_par.c): the two compare
+# values in ws2812_cc are timed at F_CPU against a period of --tcc-per
+# clocks. The few cycles the parallel backend's DMA writes lag their event
+# are not modelled.
+#
+# Exits 1 if any time is out of spec.
+
+from __future__ import print_function
+import argparse
+import re
+import subprocess
+import sys
+
+# WS2812B datasheet, ns. The strip only samples the high time, a low is
+# fine from the datasheet minimum up to a few us where some parts latch.
+LOW_MAX = 5000
+SPEC = {
+    'T0H': (250, 550),
+    'T1H': (650, 950),
+    'T0L': (700, LOW_MAX),
+    'T1L': (300, LOW_MAX),
+}
+
+parser = argparse.ArgumentParser(description='Check WS2812 timing of a built ELF')
+parser.add_argument('--f-cpu', type=int, default=48000000, help='CPU clock in Hz, F_CPU of the build')
+parser.add_argument('--spi-freq', type=int, default=3000000, help='SPI clock asked of spi_init, SPI_FREQ of the build')
+parser.add_argument('--tcc-per', type=int, default=0, help='TCC0 clocks per bit, F_CPU/800000 if 0')
+parser.add_argument('--objdump', default='arm-none-eabi-objdump', help='objdump for the target')
+parser.add_argument('elf', help='Firmware ELF or backend object')
+args = parser.parse_args()
+
+failed = False
+
+
+def objdump(*opts):
+    return subprocess.check_output([args.objdump] + list(opts) + [args.elf]).decode()
+
+
+def symbol(name):
+    """Address, size and section of a symbol, None if the ELF does not have it"""
+    for line in objdump('-t').splitlines():
+        f = line.split()
+        if f and f[-1] == name and len(f) >= 5:
+            return int(f[0], 16) & ~1, int(f[-2], 16), f[-3]
+    return None
+
+
+def report(name, ns, lo, hi):
+    global failed
+    ok = lo <= ns <= hi
+    failed |= not ok
+    print('%-6s %7.1f ns  %4d..%-5d %s' % (name, ns, lo, hi, 'ok' if ok else 'FAIL'))
+
+
+#--------------------------------------------------------------------+
+# SPI backend
+#--------------------------------------------------------------------+
+
+def contents(start, size, section):
+    # " 0f20 88888c88 c8888cc8 ...  ascii", two spaces before the ascii column
+    data = bytearray(size)
+    text = objdump('-s', '-j', section, '--start-address=0x%x' % start, '--stop-address=0x%x' % (start + size))
+    for line in text.splitlines():
+        m = re.match(r'^ ([0-9a-f]{4,8})((?: [0-9a-f]{2,8})+)  ', line + '  ')
+        if not m:
+            continue
+        addr = int(m.group(1), 16)
+        for b in bytearray.fromhex(m.group(2).replace(' ', '')):
+            if start <= addr < start + size:
+                data[addr - start] = b
+            addr += 1
+    return data
+
+
+def check_spi(start, size, section):
+    data = contents(start, size, section)
+    if size != 32:
+        sys.exit('ws2812_nibble: expected 16 symbols, got %d bytes' % size)
+
+    # BAUD as spi_init rounds it
+    baud = min(max(args.f_cpu // (2 * args.spi_freq) - 1, 0), 255)
+    freq = args.f_cpu / (2.0 * (baud + 1))
+    ns = 1e9 / freq
+    print('ws2812_nibble at %.0f Hz SPI, BAUD %d' % (freq, baud))
+    print('%-6s %10s  %-10s' % ('', 'time', 'spec ns'))
+
+    # Each symbol is 4 data bits MSB first, 4 SPI bits per data bit
+    times = {0: set(), 1: set()}
+    for nibble in range(16):
+        sym = data[2 * nibble] | (data[2 * nibble + 1] << 8)
+        for k in range(4):
+            slot = (sym >> (12 - 4 * k)) & 0xF
+            high = 0
+            while high < 4 and slot & (8 >> high):
+                high += 1
+            if slot != ((0xF0 >> high) & 0xF) or high in (0, 4):
+                sys.exit('ws2812_nibble[%d]: slot %x is not a single pulse' % (nibble, slot))
+            times[(nibble >> (3 - k)) & 1].add(high)
+
+    for bit in (0, 1):
+        if len(times[bit]) != 1:
+            sys.exit('ws2812_nibble: %d bits have more than one pulse width' % bit)
+        high = times[bit].pop()
+        report('T%dH' % bit, high * ns, *SPEC['T%dH' % bit])
+        report('T%dL' % bit, (4 - high) * ns, *SPEC['T%dL' % bit])
+    print('bit %.1f ns, %d SPI clocks' % (4 * ns, 4))
+
+
+#--------------------------------------------------------------------+
+# TCC and parallel backends
+#--------------------------------------------------------------------+
+
+def check_tcc(start, size, section):
+    data = contents(start, size, section)
+    if size != 4:
+        sys.exit('ws2812_cc: expected 2 compare values, got %d bytes' % size)
+
+    per = args.tcc_per or args.f_cpu // 800000
+    ns = 1e9 / args.f_cpu
+    print('ws2812_cc at %d Hz TCC, %d clocks per bit' % (args.f_cpu, per))
+    print('%-6s %10s  %-10s' % ('', 'time', 'spec ns'))
+
+    for bit in (0, 1):
+        high = data[2 * bit] | (data[2 * bit + 1] << 8)
+        report('T%dH' % bit, high * ns, *SPEC['T%dH' % bit])
+        report('T%dL' % bit, (per - high) * ns, *SPEC['T%dL' % bit])
+    print('bit %.1f ns, %d TCC clocks' % (per * ns, per))
+
+
+for name, check in (('ws2812_nibble', check_spi), ('ws2812_cc', check_tcc)):
+    sym = symbol(name)
+    if sym:
+        check(*sym)
+        break
+else:
+    sys.exit('%s: no WS2812 output found' % args.elf)
+
+sys.exit(1 if failed else 0)
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include "pattern.h"
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+#define WHEEL_MS	32	// per colour step
+#define WHEEL_SPREAD	5	// colour steps between neighbours
+#define CHASE_MS	20	// per pixel the head moves
+#define CHASE_TAIL	8	// pixels fading out behind the head
+#define TWINKLE_MS	16	// per decay step
+#define TWINKLE_DECAY	4	// level lost per step, about 1s from full
+#define TWINKLE_RATE	2	// new twinkles per 1024 steps and pixel
+
+struct wheel_state {
+	uint8_t pos;
+};
+
+struct chase_state {
+	uint16_t head;
+	uint16_t due;		// millis() the head moves on
+};
+
+struct twinkle_state {
+	uint16_t due;		// millis() of the next decay step
+	uint8_t level[MAXPIX];
+	uint8_t hue[MAXPIX];
+};
+
+_Static_assert(sizeof(struct twinkle_state) <= PATTERN_ARENA, "twinkle state");
+
+/*- Variables ---------------------------------------------------------------*/
+alignas(4) uint8_t pattern_arena[PATTERN_ARENA];
+
+static struct wheel_state *const wheel_st = (struct wheel_state *)pattern_arena;
+static struct chase_state *const chase_st = (struct chase_state *)pattern_arena;
+static struct twinkle_state *const twinkle_st = (struct twinkle_state *)pattern_arena;
+
+/*- Implementations ---------------------------------------------------------*/
+
+static void rgb_wheel(uint8_t led[], uint8_t pos)
+{
+	if (pos < 85) {
+		//led[0] = 85 - pos;
+		led[0] = 255 - pos * 3;
+		led[1] = pos * 3;
+		led[2] = 0;
+		return;
+	}
+	if (pos < 170) {
+		pos -= 85;
+		led[0] = 0;
+		led[1] = 255 - pos * 3;
+		led[2] = pos;
+		return;
+	}
+	pos -= 170;
+	led[0] = pos * 3;
+	led[1] = 0;
+	led[2] = 85 - pos;
+	return;
+}
+
+/* Rainbow wheel, the whole string moves one colour step at a time */
+static void wheel_init(uint16_t now)
+{
+	wheel_st->pos = now / WHEEL_MS;
+}
+
+static void wheel_step(uint16_t now)
+{
+	uint8_t pos = now / WHEEL_MS;
+
+	if (pos != wheel_st->pos) {
+		wheel_st->pos = pos;
+		neo_dirty_all();
+	}
+}
+
+static void wheel_render(uint16_t i, uint16_t now, uint16_t level[3])
+{
+	uint8_t led[3];
+
+	(void)now;
+	rgb_wheel(led, wheel_st->pos + WHEEL_SPREAD*i);
+	for (uint8_t c = 0; c < 3; c++)
+		level[c] = led[c] << 8;
+}
+
+/* A single head running along the string, only the head and tail are redrawn */
+static void chase_init(uint16_t now)
+{
+	chase_st->head = 0;
+	chase_st->due = now + CHASE_MS;
+}
+
+static void chase_step(uint16_t now)
+{
+	while ((int16_t)(now - chase_st->due) >= 0) {
+		chase_st->due += CHASE_MS;
+		if (++chase_st->head >= numpix)
+			chase_st->head = 0;
+
+		uint16_t i = chase_st->head;
+		for (uint8_t k = 0; (k <= CHASE_TAIL) && (k < numpix); k++) {
+			neo_dirty(i);
+			i = i ? i - 1 : numpix - 1;
+		}
+	}
+}
+
+static void chase_render(uint16_t i, uint16_t now, uint16_t level[3])
+{
+	uint16_t head = chase_st->head;
+	uint16_t d = (head >= i) ? head - i : head + numpix - i;
+	uint16_t value = (d < CHASE_TAIL) ? (uint32_t)(CHASE_TAIL - d) * 0xFF00 / CHASE_TAIL : 0;
+
+	(void)now;
+	level[0] = level[1] = level[2] = value;
+}
+
+/* Random pixels light up in a random colour and decay */
+static void twinkle_init(uint16_t now)
+{
+	for (uint16_t i = 0; i < MAXPIX; i++)
+		twinkle_st->level[i] = 0;
+	twinkle_st->due = now + TWINKLE_MS;
+}
+
+static void twinkle_step(uint16_t now)
+{
+	while ((int16_t)(now - twinkle_st->due) >= 0) {
+		twinkle_st->due += TWINKLE_MS;
+
+		for (uint16_t i = 0; i < numpix; i++) {
+			if (!twinkle_st->level[i])
+				continue;
+			if (twinkle_st->level[i] > TWINKLE_DECAY)
+				twinkle_st->level[i] -= TWINKLE_DECAY;
+			else
+				twinkle_st->level[i] = 0;
+			neo_dirty(i);
+		}
+
+		uint32_t r = rand32();
+		if ((r & 0x3FF) < (uint32_t)numpix * TWINKLE_RATE) {
+			uint16_t i = (r >> 10) % numpix;
+			twinkle_st->level[i] = 255;
+			twinkle_st->hue[i] = r >> 24;
+			neo_dirty(i);
+		}
+	}
+}
+
+static void twinkle_render(uint16_t i, uint16_t now, uint16_t level[3])
+{
+	uint8_t led[3];
+
+	(void)now;
+	rgb_wheel(led, twinkle_st->hue[i]);
+	for (uint8_t c = 0; c < 3; c++)
+		level[c] = led[c] * twinkle_st->level[i];
+}
+
+/* Every pixel at full, the channel limits set the colour */
+static void solid_init(uint16_t now)
+{
+	(void)now;
+}
+
+static void solid_step(uint16_t now)
+{
+	(void)now;
+}
+
+static void solid_render(uint16_t i, uint16_t now, uint16_t level[3])
+{
+	(void)i;
+	(void)now;
+	level[0] = level[1] = level[2] = 0xFF00;
+}
+
+static const struct pattern pattern_wheel = { 'w', wheel_init, wheel_step, wheel_render };
+static const struct pattern pattern_chase = { 'c', chase_init, chase_step, chase_render };
+static const struct pattern pattern_twinkle = { 't', twinkle_init, twinkle_step, twinkle_render };
+static const struct pattern pattern_solid = { 's', solid_init, solid_step, solid_render };
+
+static const struct pattern *const patterns[] = {
+	&pattern_fade,
+	&pattern_wheel,
+	&pattern_chase,
+	&pattern_twinkle,
+	&pattern_solid,
+	&pattern_show,
+};
+
+/* Registered pattern for a key, NULL if there is none */
+const struct pattern *pattern_find(char key)
+{
+	for (uint8_t k = 0; k < sizeof(patterns)/sizeof(patterns[0]); k++) {
+		if (patterns[k]->key == key)
+			return patterns[k];
+	}
+	return NULL;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PATTERN_H_
+#define _PATTERN_H_
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*- Definitions -------------------------------------------------------------*/
+/*
+ * MAXPIX is bound by the 4 KB of SRAM. A pixel costs 12 bytes of pattern
+ * state and 2*3 bytes of frame, about 18.4 with the dirty bits. The rest
+ * takes about 2.3 KB (USB stack ~1.15 KB, colour tables, profiler, DMA),
+ * and the linker script keeps 512 bytes for the stack. 300 pixels would
+ * need 5.5 KB for the pixels alone.
+ */
+#ifndef MAXPIX
+#define MAXPIX	64
+#endif
+#define PATTERN_ARENA	(MAXPIX*12 + 132)	// bytes, sized for the random fade
+
+/*
+ * The running pattern owns pattern_arena. init() starts it over at now,
+ * every pixel is rendered after it. step() advances it to now and marks the
+ * pixels it changed with neo_dirty(), render() gives the G, R, B levels of
+ * pixel i at now with 0xFF00 as full. Only dirty pixels are rendered.
+ */
+struct pattern {
+	char key;		// selects it with the m command
+	void (*init)(uint16_t now);
+	void (*step)(uint16_t now);
+	void (*render)(uint16_t i, uint16_t now, uint16_t level[3]);
+};
+
+/*- Variables ---------------------------------------------------------------*/
+extern uint8_t pattern_arena[PATTERN_ARENA];
+extern const struct pattern pattern_fade;
+extern const struct pattern pattern_show;
+extern uint16_t numpix;
+extern uint8_t pix_dirty[(MAXPIX+7)/8];
+
+/*- Prototypes --------------------------------------------------------------*/
+const struct pattern *pattern_find(char key);
+void neo_dirty_all(void);
+
+/*- Implementations ---------------------------------------------------------*/
+
+static inline void neo_dirty(uint16_t i)
+{
+	pix_dirty[i >> 3] |= 1 << (i & 7);
+}
+
+#endif // _PATTERN_H_
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "prof.h"
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+#define PROF_CYCLES_US	(F_CPU/1000000)
+
+struct prof {
+	uint32_t min;		// cycles
+	uint32_t max;
+	uint64_t sum;
+	uint32_t n;
+	uint16_t hist[PROF_BINS];	// saturating counts
+};
+
+/*- Variables ---------------------------------------------------------------*/
+// 56 bytes a timing with the uint64_t alignment, 224 for all four
+static struct prof prof[PROF_COUNT];
+
+static const char *const prof_names[PROF_COUNT] = {
+	"neo", "wire", "usb", "loop"
+};
+
+/*- Implementations ---------------------------------------------------------*/
+
+/* May be called from interrupt context, each id from one context only */
+void prof_add(enum prof_id id, uint32_t cycles)
+{
+	struct prof *p = &prof[id];
+	uint32_t us = cycles / PROF_CYCLES_US;
+	uint8_t bin = us ? 32 - __builtin_clz(us) : 0;
+
+	if (!p->n || (cycles < p->min))
+		p->min = cycles;
+	if (cycles > p->max)
+		p->max = cycles;
+	p->sum += cycles;
+	p->n++;
+
+	if (bin >= PROF_BINS)
+		bin = PROF_BINS - 1;
+	if (p->hist[bin] != 0xFFFF)
+		p->hist[bin]++;
+}
+
+void prof_reset(void)
+{
+	memset(prof, 0, sizeof(prof));
+}
+
+static void prof_print_num(uint32_t value, char sep)
+{
+	char s[12];
+
+	utoa(value, s, 10);
+	cdc_print(s);
+	s[0] = sep;
+	s[1] = '\0';
+	cdc_print(s);
+}
+
+/* One line per id: name count min max mean in us, then the histogram */
+void prof_print(void)
+{
+	for (uint8_t id = 0; id < PROF_COUNT; id++) {
+		struct prof p = prof[id];
+
+		cdc_print(prof_names[id]);
+		cdc_print("\t");
+		prof_print_num(p.n, ' ');
+		prof_print_num(p.min / PROF_CYCLES_US, ' ');
+		prof_print_num(p.max / PROF_CYCLES_US, ' ');
+		prof_print_num(p.n ? (uint32_t)(p.sum / p.n) / PROF_CYCLES_US : 0, '\t');
+		for (uint8_t k = 0; k < PROF_BINS; k++)
+			prof_print_num(p.hist[k], (k == PROF_BINS-1) ? '\n' : ' ');
+	}
+}
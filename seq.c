@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "flash.h"
+#include "pattern.h"
+#include "seq.h"
+#include "ws2812.h"
+
+/*- Definitions -------------------------------------------------------------*/
+#define SEQ_KEYS_MAX	((__show_end - __show_start - FLASH_PAGE) / sizeof(struct seq_key))
+
+struct seq_pixel {
+	uint8_t from[3];	// G, R, B when the fade started
+	uint8_t to[3];
+	uint16_t t0;		// ticks
+	uint16_t fade;
+	uint8_t ease;
+} PACK;
+
+struct seq_state {
+	uint16_t key;		// next key to apply
+	uint16_t time;		// ticks since the show started
+	uint16_t ms;		// and ms since the last tick
+	uint16_t last;		// millis() of the last step
+	uint32_t busy;		// tick the last fade started so far ends, past 0xFFFF
+	bool valid;
+	struct seq_pixel px[MAXPIX];
+};
+
+_Static_assert(sizeof(struct seq_state) <= PATTERN_ARENA, "sequencer state");
+
+/*- Variables ---------------------------------------------------------------*/
+// The header page is written last, keys start on the page after it
+static const struct seq_show *const show = (const struct seq_show *)__show_start;
+static const struct seq_key *const keys = (const struct seq_key *)(__show_start + FLASH_PAGE);
+
+static struct seq_state *const st = (struct seq_state *)pattern_arena;
+
+static struct seq_show load_hdr;
+static uint32_t load_page[FLASH_PAGE/4];
+static const uint8_t *load_addr;
+static uint16_t load_pos, load_len;
+
+/*- Implementations ---------------------------------------------------------*/
+
+/* Eased progress of a pixel at t ms into the show, 0.16 fixed point */
+static uint32_t seq_progress(const struct seq_pixel *p, uint32_t t)
+{
+	uint32_t start = (uint32_t)p->t0 * SEQ_TICK;
+	uint32_t len = (uint32_t)p->fade * SEQ_TICK;
+	uint32_t x;
+
+	if (t >= start + len)
+		return 0x10000;
+	if (t <= start)
+		return 0;
+	// a fade can last 655 s, the shift alone overflows past 65 s
+	x = ((uint64_t)(t - start) << 16) / len;
+
+	switch (p->ease) {
+	case SEQ_IN:
+		return (x * x) >> 16;
+	case SEQ_OUT:
+		x = 0x10000 - x;
+		return 0x10000 - ((x * x) >> 16);
+	case SEQ_IN_OUT:	// 3x^2 - 2x^3
+		return ((uint64_t)((x * x) >> 16) * (0x30000 - 2*x)) >> 16;
+	}
+	return x;
+}
+
+/* Colour of a pixel at t, in 8.8 */
+static void seq_color(const struct seq_pixel *p, uint32_t t, uint16_t level[3])
+{
+	int32_t e = seq_progress(p, t);
+
+	for (uint8_t c = 0; c < 3; c++)
+		level[c] = (p->from[c] << 8) + (((p->to[c] - p->from[c]) * e) >> 8);
+}
+
+static inline uint32_t seq_now(void)
+{
+	return (uint32_t)st->time * SEQ_TICK + st->ms;
+}
+
+/* Every pixel holds the colour it has now, pending fades are dropped */
+static void seq_settle(void)
+{
+	uint32_t t = seq_now();
+
+	for (uint16_t i = 0; i < numpix; i++) {
+		struct seq_pixel *p = &st->px[i];
+		uint16_t level[3];
+
+		seq_color(p, t, level);
+		for (uint8_t c = 0; c < 3; c++)
+			p->from[c] = p->to[c] = level[c] >> 8;
+		p->fade = 0;
+	}
+	st->busy = 0;
+}
+
+static void seq_apply(const struct seq_key *key)
+{
+	uint32_t t = seq_now();
+	uint32_t end = (uint32_t)key->first + key->count;
+
+	if (end > numpix)
+		end = numpix;
+
+	for (uint16_t i = key->first; i < end; i++) {
+		struct seq_pixel *p = &st->px[i];
+		uint16_t level[3];
+
+		seq_color(p, t, level);
+		for (uint8_t c = 0; c < 3; c++)
+			p->from[c] = level[c] >> 8;
+		p->to[0] = key->g;
+		p->to[1] = key->r;
+		p->to[2] = key->b;
+		p->t0 = key->time;
+		p->fade = key->fade;
+		p->ease = key->ease;
+		neo_dirty(i);
+	}
+
+	if ((uint32_t)key->time + key->fade > st->busy)
+		st->busy = (uint32_t)key->time + key->fade;
+}
+
+static void show_init(uint16_t now)
+{
+	memset(st, 0, sizeof(*st));
+	st->last = now;
+	st->valid = (show->magic == SEQ_MAGIC);
+}
+
+/*
+ * Apply the keys that are due and redraw pixels that are still fading.
+ * A show is re-read from flash every step, one that is being uploaded
+ * holds the string still and a new one starts from the top.
+ */
+static void show_step(uint16_t now)
+{
+	bool valid = (show->magic == SEQ_MAGIC);
+
+	if (valid != st->valid)
+		show_init(now);
+	if (!valid)
+		return;
+	if (!show->length && (st->key >= show->count) && (st->time > st->busy))
+		return;		// over, the time stops so it cannot wrap
+
+	st->ms += (uint16_t)(now - st->last);
+	st->last = now;
+	st->time += st->ms / SEQ_TICK;
+	st->ms %= SEQ_TICK;
+
+	if (show->length && (st->time >= show->length)) {
+		st->time = show->length;
+		st->ms = 0;
+		seq_settle();
+		st->time = 0;
+		st->key = 0;
+	}
+
+	while ((st->key < show->count) && (keys[st->key].time <= st->time))
+		seq_apply(&keys[st->key++]);
+
+	if (st->time <= st->busy) {
+		for (uint16_t i = 0; i < numpix; i++) {
+			if (st->time <= st->px[i].t0 + st->px[i].fade)
+				neo_dirty(i);
+		}
+	}
+}
+
+static void show_render(uint16_t i, uint16_t now, uint16_t level[3])
+{
+	(void)now;
+	seq_color(&st->px[i], seq_now(), level);
+}
+
+const struct pattern pattern_show = { 'p', show_init, show_step, show_render };
+
+/*
+ * Upload, fed by the stream decoder. The whole area is erased first, so a
+ * show that fails its CRC or its header check leaves no show at all.
+ * Erases and writes stall flash fetches, each waits for the frame on the
+ * wire so its DMA refills are not starved.
+ */
+bool seq_load_start(uint16_t len)
+{
+	if ((len < sizeof(struct seq_show)) ||
+			(len > sizeof(struct seq_show) + SEQ_KEYS_MAX * sizeof(struct seq_key)))
+		return false;
+
+	ws2812_wait();
+	for (const uint8_t *row = __show_start; row < __show_end; row += FLASH_ROW)
+		flash_erase_row(row);
+
+	load_addr = (const uint8_t *)keys;
+	load_pos = 0;
+	load_len = 0;
+	return true;
+}
+
+/* Where the next payload bytes go and how many fit, header first then keys */
+uint8_t *seq_load_buf(uint16_t *room)
+{
+	if (load_len < sizeof(load_hdr)) {
+		*room = sizeof(load_hdr) - load_len;
+		return (uint8_t *)&load_hdr + load_len;
+	}
+	*room = FLASH_PAGE - load_pos;
+	return (uint8_t *)load_page + load_pos;
+}
+
+void seq_load_commit(uint16_t n)
+{
+	if (load_len >= sizeof(load_hdr))
+		load_pos += n;
+	load_len += n;
+
+	if (load_pos == FLASH_PAGE) {
+		ws2812_wait();
+		flash_write_page(load_addr, load_page);
+		load_addr += FLASH_PAGE;
+		load_pos = 0;
+	}
+}
+
+/* The CRC checked out, write the rest and then the header */
+void seq_load_finish(void)
+{
+	if ((load_hdr.magic != SEQ_MAGIC) ||
+			(load_len != sizeof(load_hdr) + load_hdr.count * sizeof(struct seq_key)))
+		return;
+
+	ws2812_wait();
+	if (load_pos) {
+		memset((uint8_t *)load_page + load_pos, 0xFF, FLASH_PAGE - load_pos);
+		flash_write_page(load_addr, load_page);
+	}
+
+	memset(load_page, 0xFF, sizeof(load_page));
+	memcpy(load_page, &load_hdr, sizeof(load_hdr));
+	flash_write_page(show, load_page);
+}
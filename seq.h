@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SEQ_H_
+#define _SEQ_H_
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+/*
+ * A show is a header and a list of keys sorted by time, uploaded as one
+ * STREAM_SHOW frame and played from flash by the p pattern. At its time a
+ * key starts moving a range of pixels from whatever colour they have to
+ * its own, taking fade ticks along the easing curve. Colours are levels
+ * before gamma, like the other patterns.
+ */
+#define SEQ_MAGIC	0x574F4853	// "SHOW"
+#define SEQ_TICK	10		// ms per unit of key times
+
+enum seq_ease {
+	SEQ_LINEAR,
+	SEQ_IN,
+	SEQ_OUT,
+	SEQ_IN_OUT,
+};
+
+struct seq_show {
+	uint32_t magic;		// only written once the rest of the show is in
+	uint16_t count;		// keys
+	uint16_t length;	// ticks until the show starts over, 0 plays it once
+};
+
+struct seq_key {
+	uint16_t time;		// ticks from the start of the show
+	uint16_t fade;		// ticks to reach the colour, 0 jumps
+	uint16_t first;		// pixel range
+	uint16_t count;
+	uint8_t g, r, b;
+	uint8_t ease;		// enum seq_ease
+} PACK;
+
+/*- Prototypes --------------------------------------------------------------*/
+bool seq_load_start(uint16_t len);
+uint8_t *seq_load_buf(uint16_t *room);
+void seq_load_commit(uint16_t n);
+void seq_load_finish(void);
+
+#endif // _SEQ_H_
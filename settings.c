@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "flash.h"
+#include "color.h"
+#include "settings.h"
+#include "ws2812.h"
+
+/*- Definitions -------------------------------------------------------------*/
+#define SETTINGS_MAGIC	0x54455347	// "GSET"
+
+/*
+ * Every save appends a whole snapshot as one page, the newest valid page
+ * wins. When the row being filled is full the other one is erased and
+ * filling continues there, so the last snapshot is never erased before
+ * a newer one is written.
+ */
+struct settings_page {
+	uint32_t magic;
+	uint32_t seq;		// increases with every save
+	struct settings s;
+	uint16_t check;		// ~sum of the bytes of s
+};
+
+_Static_assert(sizeof(struct settings_page) <= FLASH_PAGE, "settings page");
+
+#define SETTINGS_PAGES	((__settings_end - __settings_start) / FLASH_PAGE)
+#define SETTINGS_ROW_PAGES	(FLASH_ROW / FLASH_PAGE)
+
+/*- Variables ---------------------------------------------------------------*/
+static const struct settings defaults = {
+	.numpix = 50,
+	.pattern = 'f',
+	.brightness = 255,
+	.limit = { 255, 255, 100 },
+	.gamma = { COLOR_GAMMA_DEFAULT, COLOR_GAMMA_DEFAULT, COLOR_GAMMA_DEFAULT },
+	.delay = SETTINGS_DELAY_MAX,	// 32s total up+down
+	.hold = 0xFF,			// 512ms
+	.wait = 0xFFF,			// 8.192s
+};
+
+struct settings settings;
+
+static uint16_t page_next;	// where the next save goes
+static uint32_t seq;
+
+/*- Implementations ---------------------------------------------------------*/
+
+static inline const struct settings_page *settings_page(uint16_t n)
+{
+	return (const struct settings_page *)(__settings_start + n * FLASH_PAGE);
+}
+
+static uint16_t settings_check(const struct settings *s)
+{
+	const uint8_t *b = (const uint8_t *)s;
+	uint16_t sum = 0;
+
+	for (uint8_t i = 0; i < sizeof(*s); i++)
+		sum += b[i];
+	return ~sum;
+}
+
+/* Scan the log once, settings then live in RAM */
+void settings_load(void)
+{
+	const struct settings_page *best = NULL;
+
+	page_next = 0;
+	for (uint16_t n = 0; n < SETTINGS_PAGES; n++) {
+		const struct settings_page *p = settings_page(n);
+
+		if ((p->magic != SETTINGS_MAGIC) || (p->check != settings_check(&p->s)))
+			continue;
+		if (!best || ((int32_t)(p->seq - best->seq) > 0)) {
+			best = p;
+			page_next = n + 1;
+		}
+	}
+
+	if (best) {
+		settings = best->s;
+		seq = best->seq;
+	}
+	else
+		settings = defaults;
+
+	// A save cut short leaves a page that is not blank, start a new row
+	if ((page_next % SETTINGS_ROW_PAGES) && (settings_page(page_next)->magic != 0xFFFFFFFF))
+		page_next += SETTINGS_ROW_PAGES - (page_next % SETTINGS_ROW_PAGES);
+	if (page_next >= SETTINGS_PAGES)
+		page_next = 0;
+}
+
+/*
+ * Append a snapshot, erasing the next row first when it starts one. NVM
+ * commands stall flash fetches, so a frame on the wire has to finish first
+ * or its DMA refills come too late.
+ */
+void settings_save(void)
+{
+	uint32_t buf[FLASH_PAGE/4];
+	struct settings_page *p = (struct settings_page *)buf;
+
+	ws2812_wait();
+	if (!(page_next % SETTINGS_ROW_PAGES))
+		flash_erase_row(settings_page(page_next));
+
+	memset(buf, 0xFF, sizeof(buf));
+	p->magic = SETTINGS_MAGIC;
+	p->seq = ++seq;
+	p->s = settings;
+	p->check = settings_check(&settings);
+	flash_write_page(settings_page(page_next), buf);
+
+	if (++page_next >= SETTINGS_PAGES)
+		page_next = 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SETTINGS_H_
+#define _SETTINGS_H_
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*- Definitions -------------------------------------------------------------*/
+#define SETTINGS_DELAY_MAX	0x1F	// fits rand_RGB.delay_max
+#define SETTINGS_WAIT_MAX	0x3FFE	// (max+1) ticks of 2ms stay below the int16_t wheel horizon
+
+/* Loaded once at boot, the CDC commands change it and w saves it */
+struct settings {
+	uint16_t numpix;
+	uint8_t pattern;	// key of the pattern at boot
+	uint8_t brightness;
+	uint8_t limit[3];	// G, R, B
+	uint8_t gamma[3];	// exponent in tenths
+	uint8_t delay;		// random fade length, up+down in units of 2ms per level
+	uint8_t hold;		// random hold at full, 2ms units
+	uint16_t wait;		// random wait off, 2ms units
+};
+
+/*- Variables ---------------------------------------------------------------*/
+extern struct settings settings;
+
+/*- Prototypes --------------------------------------------------------------*/
+void settings_load(void);
+void settings_save(void);
+
+#endif // _SETTINGS_H_
@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Runs each case of the golden file through the simulator, prints host
+# speed and checks the hash of all frames against the stored one.
+#
+# usage: bench.sh sim golden [-u]
+#   -u  store the new hashes, after a change that is meant to alter output
+#
+# Golden lines are: name hash simulator-arguments... Input files given
+# with -i are relative to the golden file.
+
+sim=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+golden=$2
+update=$3
+fail=0
+tmp=$golden.tmp
+dir=$(dirname "$golden")
+
+printf '%-13s %7s %9s %9s  %s\n' case frames ns/pixel frames/s result
+
+: > "$tmp"
+while read -r name hash args; do
+	case $name in
+	''|'#'*)
+		echo "$name $hash $args" >> "$tmp"
+		continue
+		;;
+	esac
+
+	set -- $(cd "$dir" && $sim -q $args 2>&1 >/dev/null | tail -n 1)
+	frames=$1 got=$3 ns=$4 fps=$5
+
+	if [ "$got" = "$hash" ]; then
+		result=ok
+	elif [ "$update" = "-u" ]; then
+		result="updated $hash -> $got"
+	else
+		result="FAIL $got, expected $hash"
+		fail=1
+	fi
+
+	printf '%-13s %7s %9s %9s  %s\n' "$name" "$frames" "$ns" "$fps" "$result"
+	echo "$name $got $args" >> "$tmp"
+done < "$golden"
+
+if [ "$update" = "-u" ]; then
+	mv "$tmp" "$golden"
+else
+	rm -f "$tmp"
+fi
+
+exit $fail
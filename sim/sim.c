@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host build of the firmware. main.c runs unmodified against these stubs,
+ * one pass of the main loop is one simulated ms and every frame handed to
+ * ws2812_submit is written out, so patterns can be looked at and diffed
+ * without a board.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tusb.h"
+#include "ws2812.h"
+#include "flash.h"
+#include "stream.h"
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+#define SIM_FLASH	0x800	// show and settings regions, see the Makefile
+#define SIM_CMDS	16
+#define SIM_INPUT	4096	// bytes of -i input
+#define SIM_RX		64	// input bytes arriving per ms, one USB packet
+
+/*- Variables ---------------------------------------------------------------*/
+uint8_t sim_flash[SIM_FLASH];
+uint32_t rand_state = 1;
+
+static uint32_t sim_ms, sim_spin, sim_ticks = 10000, sim_frames, sim_pixels;
+static uint32_t sim_hash = 2166136261u;	// FNV-1a over every frame
+static uint64_t sim_start, sim_out_ns;
+static FILE *sim_out;
+static bool sim_raw, sim_quiet;
+static const char *sim_cmd[SIM_CMDS];
+static int sim_ncmd, sim_nextcmd;
+static uint8_t sim_in[SIM_INPUT];
+static uint32_t sim_in_len, sim_in_pos, sim_in_ready;
+
+/*- Prototypes --------------------------------------------------------------*/
+int glowie_main(void);
+
+/*- Implementations ---------------------------------------------------------*/
+
+static uint64_t sim_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Time spent here is not counted as render time
+static void sim_frame(const uint8_t *data, uint16_t len)
+{
+	uint64_t t = sim_ns();
+
+	sim_frames++;
+	sim_pixels += len / 3;
+	for (uint16_t i = 0; i < len; i++)
+		sim_hash = (sim_hash ^ (data ? data[i] : 0)) * 16777619u;
+
+	if (sim_raw && !sim_quiet) {
+		for (uint16_t i = 0; i < len; i++)
+			fputc(data ? data[i] : 0, sim_out);
+	}
+	else if (!sim_quiet) {
+		fprintf(sim_out, "%u", sim_ms);
+		for (uint16_t i = 0; i < len; i++) {
+			if (i % 3 == 0)
+				fputc(' ', sim_out);
+			fprintf(sim_out, "%02x", data ? data[i] : 0);
+		}
+		fputc('\n', sim_out);
+	}
+
+	sim_out_ns += sim_ns() - t;
+}
+
+/* frames pixels hash ns/pixel frames/s, ns/pixel is host time per pixel sent */
+static void sim_summary(void)
+{
+	double ns = sim_ns() - sim_start - sim_out_ns;
+
+	fprintf(stderr, "%u %u %08x %.1f %.0f\n", sim_frames, sim_pixels, sim_hash,
+		sim_pixels ? ns / sim_pixels : 0, ns ? sim_frames * 1e9 / ns : 0);
+}
+
+//--------------------------------------------------------------------+
+// WS2812
+//--------------------------------------------------------------------+
+
+void ws2812_init(void)
+{
+}
+
+// Latches at once, done runs before submit returns
+void ws2812_submit(const uint8_t *data, uint16_t len, ws2812_cb_t done)
+{
+	sim_frame(data, len);
+	if (done)
+		done();
+}
+
+void ws2812_send(const uint8_t *data, uint16_t len)
+{
+	sim_frame(data, len);
+}
+
+bool ws2812_busy(void)
+{
+	return false;
+}
+
+void ws2812_wait(void)
+{
+}
+
+uint16_t ws2812_overruns(void)
+{
+	return 0;
+}
+
+void ws2812_overruns_clear(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// USB, the main loop calls tud_task once per pass
+//--------------------------------------------------------------------+
+
+void tusb_init(void)
+{
+}
+
+void tud_task(void)
+{
+	sim_spin = 0;
+	sim_in_ready = LIMIT(sim_in_ready + SIM_RX, sim_in_len);
+	if (++sim_ms > sim_ticks) {
+		fflush(sim_out);
+		sim_summary();
+		exit(0);
+	}
+}
+
+void tud_suspend_cb(bool remote_wakeup_en)
+{
+	(void) remote_wakeup_en;
+	ws2812_send(NULL, 0);
+}
+
+bool tud_cdc_connected(void)
+{
+	return true;
+}
+
+uint32_t tud_cdc_available(void)
+{
+	return sim_in_ready - sim_in_pos;
+}
+
+bool tud_cdc_peek(int pos, uint8_t *chr)
+{
+	if ((uint32_t)pos >= tud_cdc_available())
+		return false;
+	*chr = sim_in[sim_in_pos + pos];
+	return true;
+}
+
+uint32_t tud_cdc_read(void *buffer, uint32_t bufsize)
+{
+	uint32_t n = LIMIT(bufsize, tud_cdc_available());
+
+	memcpy(buffer, &sim_in[sim_in_pos], n);
+	sim_in_pos += n;
+	return n;
+}
+
+int32_t tud_cdc_read_char(void)
+{
+	uint8_t ch;
+
+	return tud_cdc_read(&ch, 1) ? ch : -1;
+}
+
+void tud_cdc_write_flush(void)
+{
+}
+
+uint32_t tud_cdc_write_char(char ch)
+{
+	fputc(ch, stderr);
+	return 1;
+}
+
+uint32_t tud_cdc_write_str(const char *str)
+{
+	fputs(str, stderr);
+	return strlen(str);
+}
+
+//--------------------------------------------------------------------+
+// Utils
+//--------------------------------------------------------------------+
+
+// A loop spinning on millis() moves time on by itself
+uint32_t millis(void)
+{
+	if (++sim_spin > 100) {
+		sim_spin = 0;
+		sim_ms++;
+	}
+	return sim_ms;
+}
+
+// Host time at the firmware clock, so z prints what the host spent
+uint32_t cycles(void)
+{
+	return sim_ns() * (F_CPU / 1000000) / 1000;
+}
+
+void delay_us(uint32_t us)
+{
+	(void) us;
+}
+
+/*
+ * One scripted command per ms, each arrives as a typed line would. Then the
+ * -i input goes through the same split as in utils.c, binary frames to the
+ * stream parser and anything else to the console.
+ */
+uint8_t cdc_task(uint8_t line[], uint8_t max)
+{
+	static uint8_t pos = 0;
+	uint8_t b;
+
+	if (sim_nextcmd < sim_ncmd) {
+		const char *cmd = sim_cmd[sim_nextcmd++];
+		uint8_t len = strnlen(cmd, max - 1);
+
+		memcpy(line, cmd, len);
+		line[len] = 0;
+		return 1;
+	}
+
+	if (!tud_cdc_available())
+		return 0;
+
+	if (stream_active() || (tud_cdc_peek(0, &b) && (b == STREAM_SYNC0))) {
+		stream_read(STREAM_CDC);
+		return 0;
+	}
+
+	while (tud_cdc_peek(0, &b) && (b != STREAM_SYNC0)) {
+		tud_cdc_read_char();
+		tud_cdc_write_char(b);
+		if (pos < max-1) {
+			if ((line[pos] = b) == '\n') {
+				line[pos] = '\0';
+				pos = 0;
+				return 1;
+			}
+			pos++;
+		}
+	}
+	return 0;
+}
+
+/* Hex bytes, whitespace and # comments to the end of the line */
+static void sim_input(const char *name)
+{
+	FILE *f = fopen(name, "r");
+	int c, digit = -1;
+
+	if (!f) {
+		perror(name);
+		exit(1);
+	}
+
+	while ((c = fgetc(f)) != EOF) {
+		if (c == '#') {
+			while ((c = fgetc(f)) != EOF && c != '\n');
+			continue;
+		}
+		if (!isxdigit(c))
+			continue;
+		c = isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+		if (digit < 0) {
+			digit = c;
+			continue;
+		}
+		if (sim_in_len == SIM_INPUT) {
+			fprintf(stderr, "%s: more than %d bytes\n", name, SIM_INPUT);
+			exit(1);
+		}
+		sim_in[sim_in_len++] = (digit << 4) | c;
+		digit = -1;
+	}
+	fclose(f);
+}
+
+void cdc_print(const char *str)
+{
+	fputs(str, stderr);
+}
+
+void print_help(void)
+{
+}
+
+int atoi2(const char *str)
+{
+	return atoi(str);
+}
+
+// Fixed seed so runs repeat, -s picks another
+void rand_init(void)
+{
+}
+
+char *utoa(unsigned value, char *str, int base)
+{
+	const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+	char *p = str, *q = str;
+
+	do {
+		*p++ = digits[value % base];
+		value /= base;
+	} while (value);
+	*p-- = 0;
+
+	while (q < p) {
+		char c = *q;
+		*q++ = *p;
+		*p-- = c;
+	}
+	return str;
+}
+
+char *itoa(int value, char *str, int base)
+{
+	if (value < 0 && base == 10) {
+		*str = '-';
+		utoa(-(unsigned)value, str + 1, base);
+		return str;
+	}
+	return utoa(value, str, base);
+}
+
+//--------------------------------------------------------------------+
+// Flash, erased to 0xFF like the real thing
+//--------------------------------------------------------------------+
+
+void flash_erase_row(const void *addr)
+{
+	memset((void *)addr, 0xFF, FLASH_ROW);
+}
+
+// Writes can only clear bits
+void flash_write_page(const void *addr, const void *data)
+{
+	uint8_t *dst = (uint8_t *)addr;
+	const uint8_t *src = data;
+
+	for (int i = 0; i < FLASH_PAGE; i++)
+		dst[i] &= src[i];
+}
+
+//--------------------------------------------------------------------+
+// Main
+//--------------------------------------------------------------------+
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-t ms] [-s seed] [-o file] [-b] [-q] [-c cmd]... [-i file]\n"
+		"  -t  run time in simulated ms, default 10000\n"
+		"  -s  random seed, default 1\n"
+		"  -o  write frames to file instead of stdout\n"
+		"  -b  raw GRB bytes instead of one text line per frame\n"
+		"  -q  no frame output, the summary on stderr only\n"
+		"  -c  console command, sent in order one per ms, e.g. -c mw -c n30\n"
+		"  -i  CDC input after the commands, hex bytes with # comments,\n"
+		"      64 bytes per ms\n"
+		"On exit frames, pixels, FNV-1a of all frames, ns/pixel and frames/s\n"
+		"are printed on stderr.\n",
+		name);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+
+	sim_out = stdout;
+	memset(sim_flash, 0xFF, sizeof(sim_flash));
+
+	while ((opt = getopt(argc, argv, "t:s:o:bqc:i:")) != -1) {
+		switch (opt) {
+		case 't':
+			sim_ticks = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			rand_state = strtoul(optarg, NULL, 0);
+			if (!rand_state)
+				rand_state = 1;
+			break;
+		case 'o':
+			sim_out = fopen(optarg, "wb");
+			if (!sim_out) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		case 'b':
+			sim_raw = true;
+			break;
+		case 'q':
+			sim_quiet = true;
+			break;
+		case 'c':
+			if (sim_ncmd == SIM_CMDS)
+				usage(argv[0]);
+			sim_cmd[sim_ncmd++] = optarg;
+			break;
+		case 'i':
+			sim_input(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	sim_start = sim_ns();
+	return glowie_main();
+}
@@ -50,8 +50,7 @@ HAL_GPIO_PIN(MOSI,            A, 8);
 //-----------------------------------------------------------------------------
 int spi_init(int freq, int mode)
 {
-  //int baud = F_CPU / (2 * freq) - 1;
-  int baud = 7; // At freq = 3E6
+  int baud = F_CPU / (2 * freq) - 1;
 
   if (baud < 0)
     baud = 0;
@@ -59,8 +58,7 @@ int spi_init(int freq, int mode)
   if (baud > 255)
     baud = 255;
 
-  //freq = F_CPU / (2 * (baud + 1));
-  freq = 3000000; // at baud = 7
+  freq = F_CPU / (2 * (baud + 1));
 
   //HAL_GPIO_MISO_in();
   //HAL_GPIO_MISO_pmuxen(SPI_SERCOM_PMUX);
@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "tusb.h"
+#include "stream.h"
+#include "seq.h"
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+#define STREAM_RECORD		6	// longest delta record
+
+enum stream_state {
+	st_header,
+	st_start,	// header taken, waiting for the back buffer
+	st_pixels,	// raw GRB into the back buffer
+	st_record,
+	st_show,	// payload to the sequencer
+	st_crc,
+	st_discard,	// payload and CRC of a rejected frame
+};
+
+/*- Variables ---------------------------------------------------------------*/
+/* CRC-16/CCITT a nibble at a time, 32 bytes of flash instead of 512 */
+static const uint16_t crc_nibble[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+static uint8_t state = st_header;
+static uint8_t type;
+static uint8_t buf[STREAM_RECORD];	// header, delta record or CRC
+static uint8_t bpos;
+static uint32_t left;		// payload bytes not yet read, then CRC when discarding
+static uint16_t pos, end;	// raw pixel bytes going to frame[pos..end)
+static uint16_t crc;
+static uint8_t *frame;		// back buffer, NULL while it holds an unsent frame
+static const uint8_t *frame_last;	// last frame sent, deltas start from it
+static uint16_t frame_max;
+static bool frame_done;		// completed frame not yet taken
+static bool frame_claimed;	// a frame started in the back buffer
+static uint32_t last_rx;
+static uint8_t src;		// enum stream_src the current frame comes from
+
+/*- Implementations ---------------------------------------------------------*/
+
+static uint16_t crc_update(uint16_t c, const uint8_t *data, uint16_t n)
+{
+	while (n--) {
+		uint8_t b = *data++;
+		c = (c << 4) ^ crc_nibble[(c >> 12) ^ (b >> 4)];
+		c = (c << 4) ^ crc_nibble[(c >> 12) ^ (b & 0x0F)];
+	}
+	return c;
+}
+
+static void stream_reset(void)
+{
+	state = st_header;
+	bpos = 0;
+}
+
+/* Skip the rest of a frame we do not take, so none of it is read as text */
+static void stream_discard(void)
+{
+	left += 2;
+	state = st_discard;
+}
+
+/*
+ * Called once per main loop before cdc_task(). dst is where frames are
+ * built, NULL while the back buffer is still waiting to go out, last the
+ * frame sent before and max the bytes either holds. A frame the host gave
+ * up on halfway is dropped after a while so text commands work again.
+ */
+void stream_task(uint8_t *dst, const uint8_t *last, uint16_t max)
+{
+	frame = dst;
+	frame_last = last;
+	frame_max = max;
+
+	if (stream_active() && (millis() - last_rx > STREAM_TIMEOUT))
+		stream_reset();
+}
+
+static uint32_t stream_rx(void *dst, uint32_t n)
+{
+#if CFG_TUD_VENDOR
+	if (src == STREAM_VENDOR)
+		return tud_vendor_read(dst, n);
+#endif
+	return tud_cdc_read(dst, n);
+}
+
+/* Read up to n more bytes into buf, true once it holds n */
+static bool stream_fill(uint8_t n)
+{
+	bpos += stream_rx(&buf[bpos], n - bpos);
+	if (bpos < n)
+		return false;
+	bpos = 0;
+	return true;
+}
+
+/* Read up to n payload bytes to dst, returns the count */
+static uint16_t stream_payload(uint8_t *dst, uint16_t n)
+{
+	n = stream_rx(dst, LIMIT(n, left));
+	crc = crc_update(crc, dst, n);
+	left -= n;
+	return n;
+}
+
+/*
+ * Drop bytes until buf starts with the sync pair, or as much of it as is
+ * in. Returns false once nothing is left, the bytes after go back to text.
+ */
+static bool stream_sync(void)
+{
+	while (bpos && ((buf[0] != STREAM_SYNC0) || ((bpos > 1) && (buf[1] != STREAM_SYNC1))))
+		memmove(buf, &buf[1], --bpos);
+	return bpos;
+}
+
+/* Header is complete and in sync, returns false if it is not one we take */
+static bool stream_start(void)
+{
+	type = buf[2];
+	left = buf[3] | ((uint16_t)buf[4] << 8);
+
+	if (!left)
+		return false;
+	if ((type == STREAM_FRAME) && (left > frame_max))
+		return false;
+
+	crc = crc_update(0xFFFF, &buf[2], 3);
+	if ((type == STREAM_FRAME) || (type == STREAM_DELTA))
+		state = st_start;
+	else if ((type == STREAM_SHOW) && seq_load_start(left))
+		state = st_show;
+	else
+		return false;
+	return true;
+}
+
+/* Length of the delta record being read, known once the index is in */
+static uint8_t stream_record_len(void)
+{
+	if (bpos < 2)
+		return 2;
+	switch (buf[1] >> (STREAM_OP_SHIFT - 8)) {
+	case STREAM_OP_PIXEL:
+		return 5;
+	case STREAM_OP_FILL:
+		return 6;
+	}
+	return 3;
+}
+
+/* Apply a complete delta record, returns false if it is out of range */
+static bool stream_record(void)
+{
+	uint16_t index = (buf[0] | ((uint16_t)buf[1] << 8));
+	uint8_t op = index >> STREAM_OP_SHIFT;
+	uint16_t count = (op == STREAM_OP_PIXEL) ? 1 : buf[2];
+	const uint8_t *grb = (op == STREAM_OP_PIXEL) ? &buf[2] : &buf[3];
+
+	index &= STREAM_INDEX_MASK;
+	if ((op > STREAM_OP_COPY) || ((index + count) * 3 > frame_max))
+		return false;
+	if ((op == STREAM_OP_COPY) && (count * 3 > left))
+		return false;		// runs past the payload into the CRC
+
+	pos = index * 3;
+	if (op == STREAM_OP_COPY) {
+		end = pos + count * 3;
+		state = st_pixels;
+		return true;
+	}
+	for (; count; count--, pos += 3)
+		memcpy(&frame[pos], grb, 3);
+	return true;
+}
+
+/*
+ * Called with data waiting on the vendor interface, or by cdc_task() while
+ * stream_active() or a sync byte is next in the FIFO. A frame is read from
+ * the interface it started on, the other one waits. Raw pixels are read
+ * from the FIFO straight into the back buffer, delta records a few bytes
+ * at a time and applied in place. The CRC pass is the only per-byte work.
+ * Nothing is read past the end of a frame, and no payload is read until
+ * there is a buffer for it, the rest waits in the FIFO and the host is
+ * held off by USB flow control. A bad frame may have been applied in part,
+ * but it is never submitted and the next delta starts over from the last
+ * frame sent. A frame that is rejected on its header or a record is
+ * skipped to its end, CRC included.
+ */
+void stream_read(enum stream_src from)
+{
+	if (!stream_active())
+		src = from;
+	else if (from != src)
+		return;
+	last_rx = millis();
+
+	while (1) {
+		switch (state) {
+		case st_header: {
+			// the sync pair first, a length is only trusted after it
+			uint8_t n = stream_rx(&buf[bpos], ((bpos < 2) ? 2 : STREAM_HEADER) - bpos);
+
+			bpos += n;
+			if (!stream_sync())
+				return;
+			if (bpos < STREAM_HEADER) {
+				if (!n)
+					return;
+				break;
+			}
+			bpos = 0;
+			if (!stream_start())
+				stream_discard();
+			break;
+		}
+		case st_start:
+			if (!frame || frame_done)
+				return;
+			frame_claimed = true;
+			if (type == STREAM_DELTA) {
+				memcpy(frame, frame_last, frame_max);
+				state = st_record;
+			}
+			else {
+				pos = 0;
+				end = left;
+				state = st_pixels;
+			}
+			break;
+		case st_pixels:
+			pos += stream_payload(&frame[pos], end - pos);
+			if (pos < end) {
+				if (!left) {
+					stream_discard();
+					break;
+				}
+				return;
+			}
+			state = left ? st_record : st_crc;
+			break;
+		case st_record: {
+			uint8_t n = stream_record_len();
+
+			bpos += stream_payload(&buf[bpos], n - bpos);
+			if (bpos < n) {
+				if (!left) {
+					stream_discard();	// record cut short, skip the CRC
+					break;
+				}
+				return;
+			}
+			if (n != stream_record_len())
+				break;		// index is in, read the rest
+			bpos = 0;
+			if (!stream_record()) {
+				stream_discard();
+				break;
+			}
+			if ((state == st_record) && !left)
+				state = st_crc;
+			break;
+		}
+		case st_show: {
+			uint16_t room;
+			uint8_t *dst = seq_load_buf(&room);
+			uint16_t n = stream_payload(dst, room);
+
+			seq_load_commit(n);
+			if (!left)
+				state = st_crc;
+			else if (n < room)
+				return;
+			break;
+		}
+		case st_crc:
+			if (!stream_fill(2))
+				return;
+			if ((buf[0] | ((uint16_t)buf[1] << 8)) == crc) {
+				if (type == STREAM_SHOW)
+					seq_load_finish();
+				else {
+					if (type == STREAM_FRAME)
+						memset(&frame[end], 0, frame_max - end);
+					frame_done = true;
+				}
+			}
+			stream_reset();
+			return;
+		case st_discard:
+			while (left) {
+				uint16_t n = stream_rx(buf, LIMIT(left, sizeof(buf)));
+
+				if (!n)
+					return;
+				left -= n;
+			}
+			stream_reset();
+			return;
+		}
+	}
+}
+
+/* A binary frame is on its way, on either interface */
+bool stream_active(void)
+{
+	return (state != st_header) || bpos;
+}
+
+/* True once when a frame starts in the back buffer, the host owns it from now */
+bool stream_claimed(void)
+{
+	bool claimed = frame_claimed;
+
+	frame_claimed = false;
+	return claimed;
+}
+
+/* True once for every frame completed in the back buffer */
+bool stream_frame(void)
+{
+	bool done = frame_done;
+
+	frame_done = false;
+	return done;
+}
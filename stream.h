@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*- Definitions -------------------------------------------------------------*/
+/*
+ * Binary frames come in on the vendor bulk interface, or share the CDC port
+ * with the text commands:
+ *
+ *   0xA5 0x5A type len_lo len_hi payload[len] crc_lo crc_hi
+ *
+ * The CRC is CRC-16/CCITT-FALSE over type, len and payload. Pixel data is
+ * GRB and goes out as is, without gamma or limits. Bad frames are dropped
+ * silently, len + 2 bytes after a rejected header are skipped and never
+ * taken for text commands.
+ *
+ * A STREAM_FRAME payload is the first len/3 pixels, the rest are blanked.
+ * A STREAM_DELTA payload is a list of records applied to the last frame
+ * sent, each starting with a 16 bit pixel index whose top bits are the op:
+ *
+ *   STREAM_OP_PIXEL	index g r b		one pixel
+ *   STREAM_OP_FILL	index count g r b	count pixels of one colour
+ *   STREAM_OP_COPY	index count grb[count]	count pixels of raw data
+ *
+ * A STREAM_SHOW payload is a sequencer show, see seq.h, and goes to flash.
+ */
+#define STREAM_SYNC0		0xA5	// never starts a text command
+#define STREAM_SYNC1		0x5A
+#define STREAM_HEADER		5	// sync, type and length
+#define STREAM_TIMEOUT		100	// ms without data before a partial frame is dropped
+
+#define STREAM_OP_SHIFT		14
+#define STREAM_INDEX_MASK	((1 << STREAM_OP_SHIFT) - 1)
+
+enum stream_type {
+	STREAM_FRAME = 0x01,
+	STREAM_DELTA = 0x02,
+	STREAM_SHOW = 0x03,
+};
+
+enum stream_src {
+	STREAM_CDC,
+	STREAM_VENDOR,
+};
+
+enum stream_op {
+	STREAM_OP_PIXEL,
+	STREAM_OP_FILL,
+	STREAM_OP_COPY,
+};
+
+/*- Prototypes --------------------------------------------------------------*/
+void stream_task(uint8_t *dst, const uint8_t *last, uint16_t max);
+void stream_read(enum stream_src from);
+bool stream_active(void);
+bool stream_claimed(void);
+bool stream_frame(void);
+
+#endif // _STREAM_H_
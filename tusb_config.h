@@ -78,6 +78,7 @@
 #define CFG_TUD_MSC                 0
 #define CFG_TUD_HID                 0
 #define CFG_TUD_MIDI                0
+#define CFG_TUD_VENDOR              1
 #define CFG_TUD_CUSTOM_CLASS        0
 
 //------------- CDC -------------//
@@ -86,6 +87,12 @@
 #define CFG_TUD_CDC_RX_BUFSIZE      64
 #define CFG_TUD_CDC_TX_BUFSIZE      64
 
+//------------- VENDOR -------------//
+
+// Bulk pipe for binary frames, nothing is sent back
+#define CFG_TUD_VENDOR_RX_BUFSIZE   64
+#define CFG_TUD_VENDOR_TX_BUFSIZE   16
+
 //------------- MSC -------------//
 
 //------------- HID -------------//
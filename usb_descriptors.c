@@ -30,7 +30,9 @@
  * Same VID/PID with different interface e.g MSC (first), then CDC (later) will possibly cause system error on PC.
  *
  * Auto ProductID layout's Bitmap:
- *   [MSB]         HID | MSC | CDC          [LSB]
+ *   [MSB]  VENDOR | MIDI | HID | MSC | CDC          [LSB]
+ *
+ * CDC and the vendor frame interface give 0x4011, CDC alone was 0x4001.
  */
 #define _PID_MAP(itf, n)  ( (CFG_TUD_##itf) << (n) )
 #define USB_PID           (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | \
@@ -117,10 +119,15 @@ enum
 	ITF_NUM_HID,
 #endif
 
+#if CFG_TUD_VENDOR
+	ITF_NUM_VENDOR,
+#endif
+
 	ITF_NUM_TOTAL
 };
 
-#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC*TUD_CDC_DESC_LEN + CFG_TUD_MSC*TUD_MSC_DESC_LEN + CFG_TUD_HID*TUD_HID_DESC_LEN)
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC*TUD_CDC_DESC_LEN + CFG_TUD_MSC*TUD_MSC_DESC_LEN + CFG_TUD_HID*TUD_HID_DESC_LEN + \
+							CFG_TUD_VENDOR*TUD_VENDOR_DESC_LEN)
 
 #if CFG_TUSB_MCU == OPT_MCU_LPC175X_6X || CFG_TUSB_MCU == OPT_MCU_LPC177X_8X || CFG_TUSB_MCU == OPT_MCU_LPC40XX
 // LPC 17xx and 40xx endpoint type (bulk/interrupt/iso) are fixed by its number
@@ -149,7 +156,12 @@ uint8_t const desc_configuration[] =
 
 #if CFG_TUD_HID
 	// Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-	TUD_HID_DESCRIPTOR(ITF_NUM_HID, 6, HID_PROTOCOL_NONE, sizeof(desc_hid_report), 0x84, 16, 10)
+	TUD_HID_DESCRIPTOR(ITF_NUM_HID, 6, HID_PROTOCOL_NONE, sizeof(desc_hid_report), 0x84, 16, 10),
+#endif
+
+#if CFG_TUD_VENDOR
+	// Interface number, string index, EP Out & EP In address, EP size
+	TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, 7, 0x05, 0x85, 64),
 #endif
 };
 
@@ -176,7 +188,8 @@ char const* string_desc_arr [] =
 	"123456",                      // 3: Serials, should use chip ID
 	"CDC",                 // 4: CDC Interface
 	"MSC",                 // 5: MSC Interface
-	"HID"                  // 6: HID
+	"HID",                 // 6: HID
+	"Frames"               // 7: Vendor, binary frames
 };
 
 static uint16_t _desc_str[33];
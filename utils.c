@@ -34,9 +34,13 @@
 #include "sam.h"
 #include "tusb.h"
 #include "utils.h"
-#include "light_ws2812_cortex.h"
+#include "ws2812.h"
+#include "stream.h"
+
+extern uint16_t numpix;
 
 static volatile uint32_t msticks = 0;
+uint32_t rand_state = 1;
 
 void SysTick_Handler(void)
 {
@@ -54,6 +58,27 @@ uint32_t millis(void)
 	return m;
 }
 
+/*
+ * Cycles since boot, wraps after 89s at 48MHz. Safe in interrupt context,
+ * a SysTick wrap whose interrupt is still pending is counted.
+ */
+uint32_t cycles(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint32_t ms, val;
+
+	__disable_irq();
+	ms = msticks;
+	val = SysTick->VAL;
+	if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+		ms++;
+		val = SysTick->VAL;
+	}
+	__set_PRIMASK(primask);
+
+	return ms * (SysTick->LOAD + 1) + (SysTick->LOAD - val);
+}
+
 void delay_us(uint32_t us)
 {
 	if (!us || (us >= SysTick->LOAD))
@@ -72,8 +97,8 @@ void delay_us(uint32_t us)
 void tud_suspend_cb(bool remote_wakeup_en)
 {
        (void) remote_wakeup_en;
-       ws2812_sendzero(50*3); // TODO: magic number
-       delay_us(200);
+       ws2812_send(NULL, numpix*3);
+       ws2812_wait();
        SysTick->CTRL &= ~(SysTick_CTRL_ENABLE_Msk); //disable systick
        uint32_t *a = (uint32_t *)(0x40000838); // Disable BOD12, SAMD11 errata #15513
        *a = 0x00000004;
@@ -113,23 +138,29 @@ void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
 
 //-----------------------------------------------------------------------------
 
-/* Retrieves full line from cdc, returns true when found */
+/*
+ * Retrieves full line from cdc, returns true when found. Binary frames are
+ * left to stream_read(), text stops at a sync byte.
+ */
 uint8_t cdc_task(uint8_t line[], uint8_t max)
 {
 	static uint8_t pos = 0;
 	uint8_t success = 0;
+	uint8_t b;
 
 	if (tud_cdc_connected() && tud_cdc_available()) {	// connected and there are data available
-		uint8_t buf[64];
-		uint8_t count = tud_cdc_read(buf, sizeof(buf));
-
-		for (uint8_t i=0; i<count; i++) {
-			tud_cdc_write_char(buf[i]);
-			if (pos < max-1) {
-				if ((line[pos] = buf[i]) == '\n') {
-					success = 1;
+		if (stream_active() || (tud_cdc_peek(0, &b) && (b == STREAM_SYNC0)))
+			stream_read(STREAM_CDC);
+		else {
+			while (!success && tud_cdc_peek(0, &b) && (b != STREAM_SYNC0)) {
+				tud_cdc_read_char();
+				tud_cdc_write_char(b);
+				if (pos < max-1) {
+					if ((line[pos] = b) == '\n') {
+						success = 1;
+					}
+					pos++;
 				}
-				pos++;
 			}
 		}
 	}
@@ -147,32 +178,43 @@ uint8_t cdc_task(uint8_t line[], uint8_t max)
 }
 
 const char help_msg[] = \
-						"Tiny usb test commands:\n" \
-						"b [ms]\ttimer blink rate\n" \
-						"d [0-255]\tled pwm\n" \
-						"h\tprint humidity\n" \
-						"t\tprint local temp\n" \
-						"o\tprint remote temp\n" \
-						"c\tprint to debug uart\n" \
-						"d\tDMA uart enable\n" \
-						"D\tDMA uart disable\n";
+						"Glowie commands:\n" \
+						"r\tprint a random number\n" \
+						"z\tblank the string for 1s\n" \
+						"Z\tsuspend\n" \
+						"n [count]\tnumber of pixels\n" \
+						"m[fwctsp]\tpattern: fade, wheel, chase, twinkle, solid, show\n" \
+						"b [0-255]\tbrightness\n" \
+						"c[rgb] [0-255]\tchannel limit\n" \
+						"g[rgb] [1-50]\tgamma in tenths, all channels without rgb\n" \
+						"d[uhw] [ticks]\tmaximum fade per level, hold and wait in 2ms ticks\n" \
+						"w\tsave settings\n" \
+						"t\ttiming statistics, T clears them\n" \
+						"0xA5 0x5A ...\tbinary frame, see stream.h\n" \
+						"?\tthis help\n";
 
-void print_help(void)
+/* Write a string, servicing USB until it all fits in the FIFO */
+void cdc_print(const char *str)
 {
-	size_t len = strlen(help_msg);
+	size_t len = strlen(str);
 	size_t pos = 0;
 	while (pos < len) {
 		uint32_t avail = tud_cdc_write_available();
 		if ((len - pos) > avail) {
-		   tud_cdc_write(&help_msg[pos], avail);
+		   tud_cdc_write(&str[pos], avail);
 		} else {
-			tud_cdc_write(&help_msg[pos], len - pos);
+			tud_cdc_write(&str[pos], len - pos);
 		}	
 		pos += avail;
 		tud_task();
 	}
 }
 
+void print_help(void)
+{
+	cdc_print(help_msg);
+}
+
 int atoi2(const char *str)
 {
 	if (*str == '\0')
@@ -198,3 +240,43 @@ int atoi2(const char *str)
 
 	return sign*res;
 }
+
+/*
+ * Seed rand32() from the chip serial and ADC noise, so boards differ and
+ * every boot starts elsewhere. The temperature sensor at 16x gain leaves
+ * the low bits of each conversion to noise, the ADC is off again after.
+ */
+void rand_init(void)
+{
+	uint32_t s = *(uint32_t *)0x0080A00C ^ *(uint32_t *)0x0080A040 ^
+		*(uint32_t *)0x0080A044 ^ *(uint32_t *)0x0080A048;
+
+	PM->APBCMASK.reg |= PM_APBCMASK_ADC;
+	GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(ADC_GCLK_ID) | GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN(0);
+	SYSCTRL->VREF.bit.TSEN = 1;
+
+	ADC->REFCTRL.reg = ADC_REFCTRL_REFSEL_INT1V;
+	ADC->CTRLB.reg = ADC_CTRLB_PRESCALER_DIV32 | ADC_CTRLB_RESSEL_12BIT;	// 1.5MHz
+	while (ADC->STATUS.bit.SYNCBUSY);
+	ADC->INPUTCTRL.reg = ADC_INPUTCTRL_MUXPOS_TEMP | ADC_INPUTCTRL_MUXNEG_GND | ADC_INPUTCTRL_GAIN_16X;
+	while (ADC->STATUS.bit.SYNCBUSY);
+	ADC->CTRLA.reg = ADC_CTRLA_ENABLE;
+	while (ADC->STATUS.bit.SYNCBUSY);
+
+	for (uint8_t i = 0; i < 64; i++) {
+		ADC->SWTRIG.reg = ADC_SWTRIG_START;
+		while (ADC->STATUS.bit.SYNCBUSY);
+		while (!ADC->INTFLAG.bit.RESRDY);
+		s = ((s << 3) | (s >> 29)) ^ ADC->RESULT.reg;
+	}
+
+	ADC->CTRLA.reg = 0;
+	while (ADC->STATUS.bit.SYNCBUSY);
+	SYSCTRL->VREF.bit.TSEN = 0;
+	GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(ADC_GCLK_ID);
+	PM->APBCMASK.reg &= ~PM_APBCMASK_ADC;
+
+	rand_state = s ? s : 1;
+	for (uint8_t i = 0; i < 8; i++)
+		rand32();
+}
@@ -35,12 +35,31 @@
 #define INLINE          static inline __attribute__((always_inline))
 #define LIMIT(a, b)     (((a) > (b)) ? (b) : (a))
 
+/*- Variables ---------------------------------------------------------------*/
+extern uint32_t rand_state;
+
 /*- Prototypes --------------------------------------------------------------*/
 uint32_t millis(void);
+uint32_t cycles(void);
 void delay_us(uint32_t us);
 uint8_t cdc_task(uint8_t line[], uint8_t max);
+void cdc_print(const char *str);
 void print_help(void);
 int atoi2(const char *str);
+void rand_init(void);
+
+/*- Implementations ---------------------------------------------------------*/
+
+/* xorshift32, 32 random bits per call, the state is never 0 */
+INLINE uint32_t rand32(void)
+{
+	uint32_t x = rand_state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return rand_state = x;
+}
 
 #endif // _UTILS_H_
 
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sam.h"
+#include "dma.h"
+#include "ws2812.h"
+#include "ws2812_ring.h"
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+/*
+ * Up to four strips at once from one frame, strip s gets the s-th equal
+ * share of the pixels. All data pins sit in byte 1 of PORT group A, so a
+ * bit slot of every strip is a single byte write:
+ *
+ *   overflow  OUTSET all pins      start of the bit
+ *   CC[0]     OUTCLR zero bits     T0H, transposed frame data
+ *   CC[1]     OUTCLR all pins      T1H
+ *
+ * TCC0 only times the slots, one DMA channel per event does the writes.
+ * The set and zero masks of a slot are staged next to each other and read
+ * by their channels with a step of 2, the all pins clear never changes.
+ * A latch slot sets nothing and the line stays low. The staging halves
+ * are refilled by ws2812_ring.c, as for SPI.
+ */
+#ifndef WS2812_STRIPS
+#define WS2812_STRIPS		4	// STRIPS in the Makefile
+#endif
+#define WS2812_LANE		1	// byte of OUTSET/OUTCLR holding the pins
+#define WS2812_DMA_ZERO		0	// CC[0], the one with the block interrupt
+#define WS2812_DMA_SET		1	// overflow
+#define WS2812_DMA_CLR		2	// CC[1]
+
+#define WS2812_PER		(F_CPU / 800000)		// TCC clocks per bit
+#define WS2812_T0H		(F_CPU / 1000 * 400 / 1000000)	// 400ns
+#define WS2812_T1H		(F_CPU / 1000 * 800 / 1000000)	// 800ns
+#define WS2812_CHUNK		48	// slots per block, 2 leds a strip or 60us on the wire
+
+_Static_assert(WS2812_STRIPS >= 1 && WS2812_STRIPS <= 4, "1 to 4 strips");
+
+/*- Variables ---------------------------------------------------------------*/
+// Compare values for a zero and a one bit, used keeps them in the object
+// for make timing
+static const uint16_t ws2812_cc[2] __attribute__((used)) = { WS2812_T0H, WS2812_T1H };
+
+// PA08, PA09, PA14, PA15 within the lane
+static const uint8_t ws2812_pin[4] = { 0x01, 0x02, 0x40, 0x80 };
+
+static uint8_t stage[2][WS2812_CHUNK][2];	// set and zero mask per slot
+static uint8_t mask;				// all pins in use
+static volatile DmacDescriptor ring_set __attribute__((aligned(16)));
+static volatile DmacDescriptor ring_zero __attribute__((aligned(16)));
+
+static const uint8_t *frame;	// start of the frame, NULL sends all off
+static uint16_t frame_len;
+static uint16_t stride;		// bytes per strip
+static uint16_t pos;		// next byte of each strip to encode
+
+/*- Implementations ---------------------------------------------------------*/
+
+static void ws2812_rewind(const uint8_t *data, uint16_t len)
+{
+	frame = data;
+	frame_len = len;
+	stride = (len / 3 + WS2812_STRIPS - 1) / WS2812_STRIPS * 3;
+	pos = 0;
+}
+
+/* Transpose the next byte of every strip into one half */
+static bool ws2812_encode(void *half)
+{
+	uint8_t (*dst)[2] = half;
+	uint8_t n = 0;
+
+	if (pos == stride)
+		return false;
+
+	while ((pos < stride) && (n < WS2812_CHUNK)) {
+		uint8_t byte[WS2812_STRIPS];
+
+		for (uint8_t s = 0; s < WS2812_STRIPS; s++) {
+			uint16_t i = s * stride + pos;
+			byte[s] = (frame && (i < frame_len)) ? frame[i] : 0;
+		}
+
+		for (uint8_t bit = 0; bit < 8; bit++, n++) {
+			uint8_t zero = 0;
+
+			for (uint8_t s = 0; s < WS2812_STRIPS; s++) {
+				if (!(byte[s] & 0x80))
+					zero |= ws2812_pin[s];
+				byte[s] <<= 1;
+			}
+			dst[n][0] = mask;
+			dst[n][1] = zero;
+		}
+		pos++;
+	}
+
+	// Start of the latch
+	for (; n < WS2812_CHUNK; n++) {
+		dst[n][0] = 0;
+		dst[n][1] = 0;
+	}
+
+	return true;
+}
+
+/* The first overflow comes one clock after the timer starts */
+static void ws2812_start(void)
+{
+	dma_ch_enable(WS2812_DMA_SET);
+	dma_ch_enable(WS2812_DMA_ZERO);
+	dma_ch_enable(WS2812_DMA_CLR);
+
+	TCC0->COUNT.reg = WS2812_PER - 1;
+	while (TCC0->SYNCBUSY.bit.COUNT);
+
+	TCC0->CTRLA.reg |= TCC_CTRLA_ENABLE;
+}
+
+/* Timer and channels off, the slot that was cut short ends low */
+static void ws2812_stop(void)
+{
+	TCC0->CTRLA.reg &= ~TCC_CTRLA_ENABLE;
+	while (TCC0->SYNCBUSY.bit.ENABLE);
+
+	dma_ch_disable(WS2812_DMA_SET);
+	dma_ch_disable(WS2812_DMA_ZERO);
+	dma_ch_disable(WS2812_DMA_CLR);
+	PORT->Group[0].OUTCLR.reg = (uint32_t)mask << (8 * WS2812_LANE);
+}
+
+static const struct ws2812_ring ws2812_par = {
+	.half = { stage[0], stage[1] },
+	.size = sizeof(stage[0]),
+	.block = WS2812_PER * WS2812_CHUNK,
+	.margin = WS2812_PER,	// the set channel reads a slot at its overflow
+	.rewind = ws2812_rewind,
+	.encode = ws2812_encode,
+	.start = ws2812_start,
+	.stop = ws2812_stop,
+};
+
+void ws2812_init(void)
+{
+	volatile uint8_t *set = (volatile uint8_t *)&PORT->Group[0].OUTSET.reg + WS2812_LANE;
+	volatile uint8_t *clr = (volatile uint8_t *)&PORT->Group[0].OUTCLR.reg + WS2812_LANE;
+
+	for (uint8_t s = 0; s < WS2812_STRIPS; s++)
+		mask |= ws2812_pin[s];
+
+	PORT->Group[0].OUTCLR.reg = (uint32_t)mask << (8 * WS2812_LANE);
+	PORT->Group[0].DIRSET.reg = (uint32_t)mask << (8 * WS2812_LANE);
+
+	PM->APBCMASK.reg |= PM_APBCMASK_TCC0;
+	GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(TCC0_GCLK_ID) | GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN(0);
+
+	TCC0->CTRLA.reg = TCC_CTRLA_SWRST;
+	while (TCC0->SYNCBUSY.bit.SWRST);
+
+	TCC0->PER.reg = WS2812_PER - 1;
+	TCC0->CC[0].reg = ws2812_cc[0];
+	TCC0->CC[1].reg = ws2812_cc[1];
+	while (TCC0->SYNCBUSY.reg);
+
+	dma_init();
+	dma_ch_trigger(WS2812_DMA_SET, TCC0_DMAC_ID_OVF);
+	dma_ch_trigger(WS2812_DMA_ZERO, TCC0_DMAC_ID_MC_0);
+	dma_ch_trigger(WS2812_DMA_CLR, TCC0_DMAC_ID_MC_1);
+	dma_ch_callback(WS2812_DMA_ZERO, ws2812_ring_done);
+
+	dma_desc_set(dma_ch_desc(WS2812_DMA_SET), &stage[0][0][0], set, WS2812_CHUNK,
+			DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_STEPSEL | DMAC_BTCTRL_STEPSIZE_X2, &ring_set);
+	dma_desc_set(&ring_set, &stage[1][0][0], set, WS2812_CHUNK,
+			DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_STEPSEL | DMAC_BTCTRL_STEPSIZE_X2, dma_ch_desc(WS2812_DMA_SET));
+
+	dma_desc_set(dma_ch_desc(WS2812_DMA_ZERO), &stage[0][0][1], clr, WS2812_CHUNK,
+			DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_STEPSEL | DMAC_BTCTRL_STEPSIZE_X2 | DMAC_BTCTRL_BLOCKACT_INT, &ring_zero);
+	dma_desc_set(&ring_zero, &stage[1][0][1], clr, WS2812_CHUNK,
+			DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_STEPSEL | DMAC_BTCTRL_STEPSIZE_X2 | DMAC_BTCTRL_BLOCKACT_INT, dma_ch_desc(WS2812_DMA_ZERO));
+
+	// One beat, looping on itself for as long as the channel is enabled
+	dma_desc_set(dma_ch_desc(WS2812_DMA_CLR), &mask, clr, 1, 0, dma_ch_desc(WS2812_DMA_CLR));
+
+	ws2812_ring_init(&ws2812_par);
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sam.h"
+#include "ws2812.h"
+#include "ws2812_ring.h"
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+/*
+ * The refill of a half has one block time to finish. The backend clock
+ * makes the deadline of every block known, so a refill that still misses
+ * it (debugger, long critical section) is caught. The line is then held
+ * low until the strip latched and the frame sent again.
+ */
+#define WS2812_LATCH_CYCLES	(F_CPU / 1000000 * WS2812_LATCH_US)
+
+/*- Variables ---------------------------------------------------------------*/
+static const struct ws2812_ring *ring;
+static uint8_t latch_blocks;	// zero blocks that make up the latch
+
+static const uint8_t *frame;	// start of the frame, kept for a retry
+static uint16_t frame_len;
+static uint8_t reset;		// zero blocks still to send before the data
+static bool latch[2];		// half holds nothing but the zero latch
+static uint8_t latched;		// latch blocks out so far
+static uint8_t half;		// half currently sent
+static uint16_t blocks;		// blocks done since start
+static uint32_t start;		// cycles() the output was started
+static uint8_t retries;
+static uint16_t overruns;
+static volatile bool busy;
+static ws2812_cb_t done_cb;
+
+/*- Implementations ---------------------------------------------------------*/
+
+/* Fill one half, returns true if it is all latch */
+static bool ws2812_fill(void *dst)
+{
+	if (reset) {
+		reset--;
+		memset(dst, 0, ring->size);
+		return false;
+	}
+
+	if (!ring->encode(dst)) {
+		memset(dst, 0, ring->size);
+		return true;
+	}
+
+	return false;
+}
+
+/* Stage the first two blocks from the start of the frame and go */
+static void ws2812_start(void)
+{
+	ring->rewind(frame, frame_len);
+	half = 0;
+	blocks = 0;
+	latched = 0;
+	latch[0] = ws2812_fill(ring->half[0]);
+	latch[1] = ws2812_fill(ring->half[1]);
+
+	// taken before the output starts, deadlines err on the early side
+	start = cycles();
+	ring->start();
+}
+
+/*
+ * One block done, DMA has moved on to the other half. Once latch_blocks
+ * blocks of pure latch are out the line has been low for WS2812_LATCH_US
+ * and the strip has latched.
+ */
+void ws2812_ring_done(uint8_t flags)
+{
+	uint8_t done = half;
+
+	half ^= 1;
+	blocks++;
+
+	if (latch[done])
+		latched++;
+
+	if ((latched == latch_blocks) || (flags & DMAC_CHINTFLAG_TERR)) {
+		ring->stop();
+		busy = false;
+		if (done_cb)
+			done_cb();
+		return;
+	}
+
+	latch[done] = ws2812_fill(ring->half[done]);
+
+	// DMA reads this half once the other one is out, too late means the
+	// wire got stale bits. Past the last pixel they run off the strip.
+	if (!latch[done] && (cycles() - start > (blocks + 1) * ring->block - ring->margin)) {
+		overruns++;
+		if (retries) {
+			retries--;
+			ring->stop();
+			reset = latch_blocks;
+			ws2812_start();
+		}
+	}
+}
+
+/* Called by the backend's ws2812_init once the hardware is set up */
+void ws2812_ring_init(const struct ws2812_ring *r)
+{
+	ring = r;
+	latch_blocks = (WS2812_LATCH_CYCLES + r->block - 1) / r->block;
+
+	// Refills must not wait for a USB transfer to be serviced
+	NVIC_SetPriority(DMAC_IRQn, 0);
+	NVIC_SetPriority(USB_IRQn, 1);
+}
+
+/* Returns once the first two blocks are staged, the rest is encoded from the DMA interrupt */
+void ws2812_submit(const uint8_t *data, uint16_t len, ws2812_cb_t done)
+{
+	ws2812_wait();
+
+	frame = data;
+	frame_len = len;
+	reset = 0;
+	retries = WS2812_RETRIES;
+	done_cb = done;
+	busy = true;
+	ws2812_start();
+}
+
+void ws2812_send(const uint8_t *data, uint16_t len)
+{
+	ws2812_submit(data, len, NULL);
+}
+
+bool ws2812_busy(void)
+{
+	return busy;
+}
+
+void ws2812_wait(void)
+{
+	while (ws2812_busy());
+}
+
+/* Blocks that missed their deadline since boot, retried or not */
+uint16_t ws2812_overruns(void)
+{
+	return overruns;
+}
+
+void ws2812_overruns_clear(void)
+{
+	overruns = 0;
+}
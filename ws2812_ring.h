@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _WS2812_RING_H_
+#define _WS2812_RING_H_
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*- Definitions -------------------------------------------------------------*/
+/*
+ * Staging engine shared by the DMA backends. A backend points two DMA
+ * descriptors at each other over a ping-pong buffer and gives the engine
+ * the two halves and a few hooks. The engine implements ws2812.h: it
+ * refills the half just sent from the block interrupt, catches refills
+ * that miss their deadline and retries the frame, and ends each frame
+ * with the latch.
+ */
+#define WS2812_LATCH_US		300	// low time to latch, WS2812B from 2017 on need 280us
+#define WS2812_RETRIES		3	// then the frame goes out as it is
+
+/*- Types -------------------------------------------------------------------*/
+struct ws2812_ring {
+	void *half[2];		// staging halves, in the order DMA reads them
+	uint16_t size;		// bytes per half
+	uint32_t block;		// cycles to send one half
+	uint32_t margin;	// cycles DMA reads a half ahead of the wire
+	// back to the first byte of the frame, NULL data sends all off
+	void (*rewind)(const uint8_t *data, uint16_t len);
+	// encode the next data into a half and zero the rest of it, false
+	// with dst untouched once the whole frame is encoded
+	bool (*encode)(void *dst);
+	void (*start)(void);	// output on, DMA reads the first half
+	void (*stop)(void);	// output off, line low
+};
+
+/*- Prototypes --------------------------------------------------------------*/
+void ws2812_ring_init(const struct ws2812_ring *ring);
+void ws2812_ring_done(uint8_t flags);
+
+#endif // _WS2812_RING_H_
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sam.h"
+#include "spi_master.h"
+#include "dma.h"
+#include "ws2812.h"
+#include "ws2812_ring.h"
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+/*
+ * Each WS2812 bit is sent as 4 SPI bits at 3MHz, 1.33us per bit:
+ * 1000 for a zero (333ns high), 1100 for a one (667ns high).
+ * Every data byte becomes 4 SPI bytes, MOSI idles low between frames.
+ *
+ * The frame is never expanded in RAM. Two descriptors form a ring over a
+ * ping-pong staging buffer, each block raises an interrupt and
+ * ws2812_ring.c refills the half just sent while DMA clocks out the other
+ * one.
+ */
+#ifndef WS2812_SPI_FREQ
+#define WS2812_SPI_FREQ		3000000	// SPI_FREQ in the Makefile
+#endif
+#define WS2812_SPI_BIT		(F_CPU / (2 * WS2812_SPI_FREQ) * 2)	// cycles per SPI bit, as spi_init rounds
+#define WS2812_DMA_CH		0
+#define WS2812_CHUNK		32	// SPI bytes per block, 8 data bytes or 85us on the wire
+
+/*- Variables ---------------------------------------------------------------*/
+// SPI symbols for one data nibble, sent MSB first
+static const uint16_t ws2812_nibble[16] = {
+	0x8888, 0x888C, 0x88C8, 0x88CC, 0x8C88, 0x8C8C, 0x8CC8, 0x8CCC,
+	0xC888, 0xC88C, 0xC8C8, 0xC8CC, 0xCC88, 0xCC8C, 0xCCC8, 0xCCCC
+};
+
+static uint8_t stage[2][WS2812_CHUNK];
+static volatile DmacDescriptor ring_desc __attribute__((aligned(16)));
+
+static const uint8_t *src;	// next data byte, NULL sends all off
+static uint16_t remaining;	// data bytes not yet encoded
+
+/*- Implementations ---------------------------------------------------------*/
+
+static void ws2812_rewind(const uint8_t *data, uint16_t len)
+{
+	src = data;
+	remaining = len;
+}
+
+static bool ws2812_encode(void *half)
+{
+	uint8_t *dst = half;
+	uint8_t n = 0;
+
+	if (!remaining)
+		return false;
+
+	while (remaining && (n < WS2812_CHUNK)) {
+		uint8_t byte = src ? *src++ : 0;
+		uint16_t hi = ws2812_nibble[byte >> 4];
+		uint16_t lo = ws2812_nibble[byte & 0x0F];
+
+		dst[n++] = hi >> 8;
+		dst[n++] = hi;
+		dst[n++] = lo >> 8;
+		dst[n++] = lo;
+		remaining--;
+	}
+
+	// Start of the latch
+	while (n < WS2812_CHUNK)
+		dst[n++] = 0;
+
+	return true;
+}
+
+static void ws2812_start(void)
+{
+	dma_ch_enable(WS2812_DMA_CH);
+}
+
+static void ws2812_stop(void)
+{
+	dma_ch_disable(WS2812_DMA_CH);
+}
+
+static const struct ws2812_ring ws2812_spi = {
+	.half = { stage[0], stage[1] },
+	.size = WS2812_CHUNK,
+	.block = WS2812_SPI_BIT * 8 * WS2812_CHUNK,
+	.margin = WS2812_SPI_BIT * 8 * 3,	// DMA runs 2 bytes ahead of the wire
+	.rewind = ws2812_rewind,
+	.encode = ws2812_encode,
+	.start = ws2812_start,
+	.stop = ws2812_stop,
+};
+
+void ws2812_init(void)
+{
+	spi_init(WS2812_SPI_FREQ, 0);
+	dma_init();
+	dma_ch_trigger(WS2812_DMA_CH, SERCOM0_DMAC_ID_TX);
+	dma_ch_callback(WS2812_DMA_CH, ws2812_ring_done);
+
+	dma_desc_set(dma_ch_desc(WS2812_DMA_CH), stage[0], &SERCOM0->SPI.DATA.reg, WS2812_CHUNK,
+			DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_BLOCKACT_INT, &ring_desc);
+	dma_desc_set(&ring_desc, stage[1], &SERCOM0->SPI.DATA.reg, WS2812_CHUNK,
+			DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_BLOCKACT_INT, dma_ch_desc(WS2812_DMA_CH));
+
+	ws2812_ring_init(&ws2812_spi);
+}
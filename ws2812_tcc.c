@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2020, DNBDMR
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sam.h"
+#include "hal_gpio.h"
+#include "dma.h"
+#include "ws2812.h"
+#include "ws2812_ring.h"
+#include "utils.h"
+
+/*- Definitions -------------------------------------------------------------*/
+/*
+ * TCC0 runs single slope PWM at one WS2812 bit per period, 1.25us. The
+ * output goes high at the start of a period and low at the compare match,
+ * so every bit is one compare value: T0H for a zero, T1H for a one and 0
+ * for the latch, which keeps the line low the whole period.
+ *
+ * Each overflow triggers a DMA beat into the buffered compare register, it
+ * takes effect at the next overflow. The two staging halves are refilled
+ * by ws2812_ring.c, as for SPI.
+ */
+HAL_GPIO_PIN(WS2812,		A, 8);
+#define WS2812_TCC_PMUX		PORT_PMUX_PMUXE_E_Val
+#define WS2812_TCC_CC		2	// TCC0/WO[2] on PA08
+#define WS2812_DMA_CH		0
+
+#define WS2812_PER		(F_CPU / 800000)		// TCC clocks per bit
+#define WS2812_T0H		(F_CPU / 1000 * 400 / 1000000)	// 400ns
+#define WS2812_T1H		(F_CPU / 1000 * 800 / 1000000)	// 800ns
+#define WS2812_CHUNK		48	// beats per block, 2 leds or 60us on the wire
+
+/*- Variables ---------------------------------------------------------------*/
+// Compare values for a zero and a one bit, used keeps them in the object
+// for make timing
+static const uint16_t ws2812_cc[2] __attribute__((used)) = { WS2812_T0H, WS2812_T1H };
+
+static uint16_t stage[2][WS2812_CHUNK];
+static volatile DmacDescriptor ring_desc __attribute__((aligned(16)));
+
+static const uint8_t *src;	// next data byte, NULL sends all off
+static uint16_t remaining;	// data bytes not yet encoded
+
+/*- Implementations ---------------------------------------------------------*/
+
+static void ws2812_rewind(const uint8_t *data, uint16_t len)
+{
+	src = data;
+	remaining = len;
+}
+
+static bool ws2812_encode(void *half)
+{
+	uint16_t *dst = half;
+	uint8_t n = 0;
+
+	if (!remaining)
+		return false;
+
+	while (remaining && (n < WS2812_CHUNK)) {
+		uint8_t byte = src ? *src++ : 0;
+
+		for (uint8_t bit = 0; bit < 8; bit++, byte <<= 1)
+			dst[n++] = ws2812_cc[byte >> 7];
+		remaining--;
+	}
+
+	// Start of the latch
+	while (n < WS2812_CHUNK)
+		dst[n++] = 0;
+
+	return true;
+}
+
+static void ws2812_start(void)
+{
+	dma_ch_enable(WS2812_DMA_CH);
+}
+
+static void ws2812_stop(void)
+{
+	dma_ch_disable(WS2812_DMA_CH);
+}
+
+static const struct ws2812_ring ws2812_tcc = {
+	.half = { stage[0], stage[1] },
+	.size = sizeof(stage[0]),
+	.block = WS2812_PER * WS2812_CHUNK,
+	.margin = WS2812_PER * 2,	// DMA writes one bit ahead of the wire
+	.rewind = ws2812_rewind,
+	.encode = ws2812_encode,
+	.start = ws2812_start,
+	.stop = ws2812_stop,
+};
+
+/* The counter runs from here on, DMA is only enabled while a frame is sent */
+void ws2812_init(void)
+{
+	HAL_GPIO_WS2812_out();
+	HAL_GPIO_WS2812_clr();
+	HAL_GPIO_WS2812_pmuxen(WS2812_TCC_PMUX);
+
+	PM->APBCMASK.reg |= PM_APBCMASK_TCC0;
+	GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID(TCC0_GCLK_ID) | GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN(0);
+
+	TCC0->CTRLA.reg = TCC_CTRLA_SWRST;
+	while (TCC0->SYNCBUSY.bit.SWRST);
+
+	TCC0->WAVE.reg = TCC_WAVE_WAVEGEN_NPWM;
+	TCC0->PER.reg = WS2812_PER - 1;
+	TCC0->CC[WS2812_TCC_CC].reg = 0;
+	while (TCC0->SYNCBUSY.reg);
+
+	TCC0->CTRLA.reg = TCC_CTRLA_PRESCALER_DIV1 | TCC_CTRLA_ENABLE;
+	while (TCC0->SYNCBUSY.bit.ENABLE);
+
+	dma_init();
+	dma_ch_trigger(WS2812_DMA_CH, TCC0_DMAC_ID_OVF);
+	dma_ch_callback(WS2812_DMA_CH, ws2812_ring_done);
+
+	dma_desc_set(dma_ch_desc(WS2812_DMA_CH), stage[0], &TCC0->CCB[WS2812_TCC_CC].reg, WS2812_CHUNK,
+			DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_BLOCKACT_INT, &ring_desc);
+	dma_desc_set(&ring_desc, stage[1], &TCC0->CCB[WS2812_TCC_CC].reg, WS2812_CHUNK,
+			DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_BLOCKACT_INT, dma_ch_desc(WS2812_DMA_CH));
+
+	ws2812_ring_init(&ws2812_tcc);
+}